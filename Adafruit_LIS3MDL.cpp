@@ -22,8 +22,24 @@
 
 #include "Arduino.h"
 #include <Adafruit_LIS3MDL.h>
+#include <Adafruit_LIS3MDL_Power.h>
 #include <Wire.h>
 
+// The rate the part runs at for a CTRL_REG1/CTRL_REG3 pair: FAST_ODR rates
+// follow OM, and LP forces 0.625 Hz whatever the DO bits hold
+static lis3mdl_dataRate_t lis3mdl_effectiveDataRate(uint8_t ctrl1,
+                                                    uint8_t ctrl3) {
+  static const lis3mdl_dataRate_t fastRates[4] = {
+      LIS3MDL_DATARATE_1000_HZ, LIS3MDL_DATARATE_560_HZ,
+      LIS3MDL_DATARATE_300_HZ, LIS3MDL_DATARATE_155_HZ};
+
+  if (ctrl3 & 0x20) // LP
+    return LIS3MDL_DATARATE_0_625_HZ;
+  if (ctrl1 & 0x02) // FAST_ODR
+    return fastRates[(ctrl1 >> 5) & 0x03];
+  return (lis3mdl_dataRate_t)((ctrl1 >> 1) & 0x0E);
+}
+
 /**************************************************************************/
 /*!
     @brief  Instantiates a new LIS3MDL class
@@ -46,6 +62,8 @@ bool Adafruit_LIS3MDL::begin_I2C(uint8_t i2c_address, TwoWire *wire) {
     delete spi_dev;
 
   spi_dev = NULL;
+  _spi = NULL;
+  _frequency = 100000; // Wire.begin() starts at the standard-mode clock
   i2c_dev = new Adafruit_I2CDevice(i2c_address, wire);
 
   if (!i2c_dev->begin()) {
@@ -69,6 +87,9 @@ boolean Adafruit_LIS3MDL::begin_SPI(uint8_t cs_pin, SPIClass *theSPI,
     delete spi_dev;
 
   i2c_dev = NULL;
+  _spi = theSPI;
+  _cs = cs_pin;
+  _frequency = frequency;
   spi_dev = new Adafruit_SPIDevice(cs_pin,
                                    frequency,             // frequency
                                    SPI_BITORDER_MSBFIRST, // bit order
@@ -98,6 +119,7 @@ bool Adafruit_LIS3MDL::begin_SPI(int8_t cs_pin, int8_t sck_pin, int8_t miso_pin,
     delete spi_dev;
 
   i2c_dev = NULL;
+  _spi = NULL;
   spi_dev = new Adafruit_SPIDevice(cs_pin, sck_pin, miso_pin, mosi_pin,
                                    frequency,             // frequency
                                    SPI_BITORDER_MSBFIRST, // bit order
@@ -144,7 +166,8 @@ bool Adafruit_LIS3MDL::_init(void) {
 /**************************************************************************/
 /*!
 
-@brief  Performs a software reset
+@brief  Performs a software reset, waiting at most 10 ms for SOFT_RST to
+clear itself
 */
 /**************************************************************************/
 void Adafruit_LIS3MDL::reset(void) {
@@ -154,11 +177,244 @@ void Adafruit_LIS3MDL::reset(void) {
   Adafruit_BusIO_RegisterBits resetbits =
       Adafruit_BusIO_RegisterBits(&CTRL_REG2, 1, 2);
   resetbits.write(0x1);
-  delay(10);
+  uint32_t start = millis();
+  while (resetbits.read() && millis() - start < 10)
+    delayMicroseconds(100);
+  _selfTest = false;
+  _settling = LIS3MDL_SETTLE_SAMPLES;
 
   getRange();
 }
 
+/**************************************************************************/
+/*!
+    @brief  Find the fastest bus clock that works reliably and keep it.
+    Clocks are tried from slowest to fastest, up to the chip's limit (10 MHz
+    SPI, 400 kHz I2C), until one fails a probe of repeated WHO_AM_I reads
+    and INT_THS pattern readbacks. For margin, the clock below the last
+    passing one is kept, unless every clock up to the limit passed.
+    Software SPI is left alone.
+    @param  maxFrequency Highest clock to try in Hz, 0 for the chip's limit.
+    If it is below the slowest clock in the table the bus is not touched.
+    @returns The clock in use, or 0 if the bus clock cannot be changed or no
+    clock passed. With no clock passing, the clock from before the call is
+    put back.
+*/
+/**************************************************************************/
+uint32_t Adafruit_LIS3MDL::negotiateBusSpeed(uint32_t maxFrequency) {
+  static const uint32_t spiClocks[] = {1000000, 2000000, 4000000,
+                                       6000000, 8000000, 10000000};
+  static const uint32_t i2cClocks[] = {100000, 400000};
+  const uint32_t *clocks = i2c_dev ? i2cClocks : spiClocks;
+  uint8_t count = i2c_dev ? sizeof(i2cClocks) / sizeof(i2cClocks[0])
+                          : sizeof(spiClocks) / sizeof(spiClocks[0]);
+  uint8_t ths[2];
+  int8_t passed = -1;
+
+  if (!i2c_dev && !_spi)
+    return 0;
+  if (maxFrequency && maxFrequency < clocks[0])
+    return 0; // even the slowest clock would break the caller's limit
+  if (maxFrequency)
+    while (clocks[count - 1] > maxFrequency)
+      count--;
+
+  // Saved at the current, known-good clock and restored at the chosen one
+  if (!readRegisters(LIS3MDL_REG_INT_THS_L, ths, 2))
+    return 0;
+  while (passed + 1 < count) {
+    if (!setBusSpeed(clocks[passed + 1]) || !probeBus())
+      break;
+    passed++;
+  }
+
+  if (passed > 0 && passed + 1 < count) // a clock failed, back off one
+    passed--;
+  if (passed >= 0)
+    setBusSpeed(clocks[passed]);
+  else // nothing passed, go back to the previous clock
+    setBusSpeed(_frequency);
+  writeRegisters(LIS3MDL_REG_INT_THS_L, ths, 2);
+  if (passed >= 0)
+    _frequency = clocks[passed];
+  return passed < 0 ? 0 : clocks[passed];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Change the bus clock, recreating the SPI device if needed
+    @param  frequency Clock in Hz
+    @returns False if the clock could not be set
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL::setBusSpeed(uint32_t frequency) {
+  if (i2c_dev)
+    return i2c_dev->setSpeed(frequency);
+
+  delete spi_dev;
+  spi_dev = new Adafruit_SPIDevice(_cs, frequency, SPI_BITORDER_MSBFIRST,
+                                   SPI_MODE0, _spi);
+  return spi_dev->begin();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Check communication at the current clock: WHO_AM_I and two
+    complementary INT_THS patterns, each read back several times
+    @returns True if every transfer returned the expected bytes
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL::probeBus(void) {
+  uint8_t patterns[2][2] = {{0x55, 0x2A}, {0xAA, 0x55}}; // THS_H bit 7 is 0
+  uint8_t buffer[2];
+
+  for (uint8_t i = 0; i < 4; i++) {
+    if (!readRegisters(LIS3MDL_REG_WHO_AM_I, buffer, 1) || buffer[0] != 0x3D)
+      return false;
+    uint8_t *pattern = patterns[i & 1];
+    if (!writeRegisters(LIS3MDL_REG_INT_THS_L, pattern, 2) ||
+        !readRegisters(LIS3MDL_REG_INT_THS_L, buffer, 2) ||
+        buffer[0] != pattern[0] || buffer[1] != pattern[1])
+      return false;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read consecutive registers in one auto-incrementing burst
+    @param  reg First register address
+    @param  buffer Where to store the values
+    @param  len Number of registers to read
+    @returns True on success
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL::readRegisters(uint8_t reg, uint8_t *buffer,
+                                     uint8_t len) {
+  Adafruit_BusIO_Register regs = Adafruit_BusIO_Register(
+      i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC, reg, len);
+  return regs.read(buffer, len);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Write consecutive registers in one auto-incrementing burst. The
+    cached range is not updated; call getRange() after writing CTRL_REG2.
+    A write covering CTRL_REG1, CTRL_REG2 or CTRL_REG4 changes the rate,
+    self-test, range or Z mode, so the next samples are flagged as
+    settling. CTRL_REG3 alone does not, so single-shot triggers written
+    here are not flagged.
+    @param  reg First register address
+    @param  buffer Values to write
+    @param  len Number of registers to write
+    @returns True on success
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL::writeRegisters(uint8_t reg, uint8_t *buffer,
+                                      uint8_t len) {
+  Adafruit_BusIO_Register regs = Adafruit_BusIO_Register(
+      i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC, reg, len);
+  if (!regs.write(buffer, len))
+    return false;
+
+  for (uint8_t i = 0; i < len; i++) {
+    uint8_t r = reg + i;
+    if (r == LIS3MDL_REG_CTRL_REG1)
+      _selfTest = buffer[i] & 0x01;
+    if (r == LIS3MDL_REG_CTRL_REG1 || r == LIS3MDL_REG_CTRL_REG2 ||
+        r == LIS3MDL_REG_CTRL_REG4)
+      _settling = LIS3MDL_SETTLE_SAMPLES;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Snapshot every register in two bursts: WHO_AM_I, then 0x20
+    through 0x33 in one read, so the settings, STATUS and outputs are
+    consistent with each other. Reading is not free of side effects: the
+    outputs clear the data-ready bits, and INT_SRC clears a latched
+    interrupt.
+    @param  dump Where to store the registers
+    @returns True on success
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL::dumpRegisters(lis3mdl_registers_t *dump) {
+  return readRegisters(LIS3MDL_REG_WHO_AM_I, &dump->whoAmI, 1) &&
+         readRegisters(LIS3MDL_DUMP_FIRST, dump->regs, LIS3MDL_DUMP_LENGTH);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Decode a register snapshot. dataRate is the rate the part
+    actually runs at: with FAST_ODR set it follows the X/Y performance mode,
+    and with LP set it is 0.625 Hz whatever CTRL_REG1 holds.
+    @param  dump Registers from dumpRegisters()
+    @param  decoded Where to store the fields
+*/
+/**************************************************************************/
+void lis3mdl_decodeRegisters(const lis3mdl_registers_t *dump,
+                             lis3mdl_decoded_t *decoded) {
+  const uint8_t *r = dump->regs;
+  uint8_t ctrl1 = r[0], ctrl2 = r[1], ctrl3 = r[2], ctrl4 = r[3];
+  uint8_t ctrl5 = r[4], intCfg = r[LIS3MDL_REG_INT_CFG - LIS3MDL_DUMP_FIRST];
+
+  decoded->performanceMode = (lis3mdl_performancemode_t)((ctrl1 >> 5) & 0x03);
+  decoded->dataRate = lis3mdl_effectiveDataRate(ctrl1, ctrl3);
+  decoded->temperature = ctrl1 & 0x80;
+  decoded->selfTest = ctrl1 & 0x01;
+  decoded->range = (lis3mdl_range_t)((ctrl2 >> 5) & 0x03);
+  decoded->lowPower = ctrl3 & 0x20;
+  decoded->spi3Wire = ctrl3 & 0x04;
+  // MD = 10 is power-down as well
+  decoded->operationMode =
+      (ctrl3 & 0x02) ? LIS3MDL_POWERDOWNMODE
+                     : (lis3mdl_operationmode_t)(ctrl3 & 0x01);
+  decoded->performanceModeZ = (lis3mdl_performancemode_t)((ctrl4 >> 2) & 0x03);
+  decoded->bigEndian = ctrl4 & 0x02;
+  decoded->fastRead = ctrl5 & 0x80;
+  decoded->blockDataUpdate = ctrl5 & 0x40;
+
+  decoded->status = r[LIS3MDL_REG_STATUS - LIS3MDL_DUMP_FIRST];
+  for (uint8_t a = 0; a < 3; a++) {
+    const uint8_t *out = r + LIS3MDL_REG_OUT_X_L - LIS3MDL_DUMP_FIRST + 2 * a;
+    decoded->out[a] = (int16_t)(out[0] | (out[1] << 8));
+  }
+  const uint8_t *temp = r + LIS3MDL_REG_TEMP_OUT_L - LIS3MDL_DUMP_FIRST;
+  decoded->tempOut = (int16_t)(temp[0] | (temp[1] << 8));
+
+  decoded->intAxes = ((intCfg >> 7) & 0x01) | ((intCfg >> 5) & 0x02) |
+                     ((intCfg >> 3) & 0x04); // XIEN, YIEN, ZIEN
+  decoded->intActiveHigh = intCfg & 0x04;
+  decoded->intLatched = intCfg & 0x02;
+  decoded->intEnabled = intCfg & 0x01;
+  decoded->intSource = r[LIS3MDL_REG_INT_SRC - LIS3MDL_DUMP_FIRST];
+  const uint8_t *ths = r + LIS3MDL_REG_INT_THS_L - LIS3MDL_DUMP_FIRST;
+  decoded->intThreshold = (ths[0] | (ths[1] << 8)) & 0x7FFF;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Compare a snapshot against an expected one, for example a dump
+    taken when the device was commissioned
+    @param  actual Registers read now
+    @param  expected Registers expected
+    @param  mask LIS3MDL_DUMP_BIT() bits to compare; the default covers the
+    configuration and leaves out STATUS, the outputs and INT_SRC
+    @returns LIS3MDL_DUMP_BIT() bits of the registers that differ, 0 if none
+*/
+/**************************************************************************/
+uint32_t lis3mdl_diffRegisters(const lis3mdl_registers_t *actual,
+                               const lis3mdl_registers_t *expected,
+                               uint32_t mask) {
+  uint32_t diff = actual->whoAmI != expected->whoAmI ? 1 : 0;
+
+  for (uint8_t i = 0; i < LIS3MDL_DUMP_LENGTH; i++)
+    if (actual->regs[i] != expected->regs[i])
+      diff |= 1UL << (i + 1);
+  return diff & mask;
+}
+
 /**************************************************************************/
 /*!
   @brief  Read the XYZ data from the magnetometer and store in the internal
@@ -179,56 +435,213 @@ void Adafruit_LIS3MDL::read(void) {
   z = buffer[4];
   z |= buffer[5] << 8;
 
-  float scale = 1; // LSB per gauss
-  switch (rangeBuffered) {
-  case LIS3MDL_RANGE_16_GAUSS:
-    scale = 1711;
-    break;
-  case LIS3MDL_RANGE_12_GAUSS:
-    scale = 2281;
-    break;
-  case LIS3MDL_RANGE_8_GAUSS:
-    scale = 3421;
-    break;
-  case LIS3MDL_RANGE_4_GAUSS:
-    scale = 6842;
-    break;
-  }
+#ifndef LIS3MDL_NO_FLOAT
+  float scale = lis3mdl_rangeToLSBPerGauss(rangeBuffered);
 
   x_gauss = (float)x / scale;
   y_gauss = (float)y / scale;
   z_gauss = (float)z / scale;
+#endif
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read STATUS and the XYZ data in one 7-byte burst, so the status
+    bits always describe the returned sample. The x/y/z members are updated
+    as well.
+    @param  sample Pointer to a lis3mdl_sample_t to fill in
+    @returns True on successful read
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL::readSample(lis3mdl_sample_t *sample) {
+  uint8_t buffer[7];
+
+  Adafruit_BusIO_Register StatusXYZReg = Adafruit_BusIO_Register(
+      i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC, LIS3MDL_REG_STATUS, 7);
+  if (!StatusXYZReg.read(buffer, 7))
+    return false;
+
+  lis3mdl_unpackSample(buffer, sample);
+  sample->timestamp = millis();
+  if (_selfTest)
+    sample->flags |= LIS3MDL_FLAG_SELFTEST;
+  if (_settling) {
+    sample->flags |= LIS3MDL_FLAG_SETTLING;
+    if (!(sample->flags & LIS3MDL_FLAG_STALE))
+      _settling--;
+  }
+  x = sample->x;
+  y = sample->y;
+  z = sample->z;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read only some axes, in one burst over just the output registers
+    that cover them: Z alone is the 2 bytes at OUT_Z_L instead of 6. X with
+    Z reads through Y, since one burst costs less than two transactions.
+    The matching x/y/z members are updated as well.
+    @param  axes LIS3MDL_AXIS_* bits to read
+    @param  data X/Y/Z in raw units; entries of axes not asked for are left
+    untouched
+    @returns True on successful read
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL::readAxes(uint8_t axes, int16_t data[3]) {
+  uint8_t buffer[6], first = 0, last = 2;
+  int16_t *member[3] = {&x, &y, &z};
+
+  axes &= LIS3MDL_AXIS_XYZ;
+  if (!axes)
+    return false;
+  while (!(axes & (1 << first)))
+    first++;
+  while (!(axes & (1 << last)))
+    last--;
+
+  uint8_t len = 2 * (last - first + 1);
+  Adafruit_BusIO_Register OutReg = Adafruit_BusIO_Register(
+      i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC,
+      LIS3MDL_REG_OUT_X_L + 2 * first, len);
+  if (!OutReg.read(buffer, len))
+    return false;
+
+  for (uint8_t a = first; a <= last; a++) {
+    if (!(axes & (1 << a)))
+      continue;
+    uint8_t *out = buffer + 2 * (a - first);
+    data[a] = (int16_t)(out[0] | (out[1] << 8));
+    *member[a] = data[a];
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Check the per-axis data-ready bits, for pairing with
+    readAxes(). A single-axis poll is then 1 STATUS byte plus 2 data bytes.
+    @param  axes LIS3MDL_AXIS_* bits of interest
+    @returns The subset of axes with new data, as XDA/YDA/ZDA share the
+    LIS3MDL_AXIS_* bit positions; 0 on a failed read
+*/
+/**************************************************************************/
+uint8_t Adafruit_LIS3MDL::axesAvailable(uint8_t axes) {
+  uint8_t status;
+
+  Adafruit_BusIO_Register REG_STATUS = Adafruit_BusIO_Register(
+      i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC, LIS3MDL_REG_STATUS, 1);
+  if (!REG_STATUS.read(&status, 1))
+    return 0;
+  return status & axes & LIS3MDL_AXIS_XYZ;
 }
 
 /**************************************************************************/
 /*!
-    @brief  Gets the most recent sensor event, Adafruit Unified Sensor format
+    @brief  Decode a STATUS + OUT_X_L..OUT_Z_H burst. The timestamp is left
+    for the caller to fill in.
+    @param  buffer The 7 bytes read starting at LIS3MDL_REG_STATUS
+    @param  sample Pointer to a lis3mdl_sample_t to fill in
+*/
+/**************************************************************************/
+void lis3mdl_unpackSample(const uint8_t *buffer, lis3mdl_sample_t *sample) {
+  sample->status = buffer[0];
+  sample->x = (int16_t)(buffer[1] | (buffer[2] << 8));
+  sample->y = (int16_t)(buffer[3] | (buffer[4] << 8));
+  sample->z = (int16_t)(buffer[5] | (buffer[6] << 8));
+  sample->flags = lis3mdl_sampleFlags(sample);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Quality flags that follow from a sample alone: stale and overrun
+    from its STATUS byte, and saturation from its counts. Settling and
+    self-test depend on driver state and are added by readSample().
+    @param  sample The sample
+    @returns LIS3MDL_FLAG_* bits
+*/
+/**************************************************************************/
+uint8_t lis3mdl_sampleFlags(const lis3mdl_sample_t *sample) {
+  uint8_t flags = 0;
+
+  if (!(sample->status & 0x08)) // ZYXDA
+    flags |= LIS3MDL_FLAG_STALE;
+  if (sample->status & 0x80) // ZYXOR
+    flags |= LIS3MDL_FLAG_OVERRUN;
+  if (sample->x >= LIS3MDL_SATURATION_COUNTS ||
+      sample->x <= -LIS3MDL_SATURATION_COUNTS ||
+      sample->y >= LIS3MDL_SATURATION_COUNTS ||
+      sample->y <= -LIS3MDL_SATURATION_COUNTS ||
+      sample->z >= LIS3MDL_SATURATION_COUNTS ||
+      sample->z <= -LIS3MDL_SATURATION_COUNTS)
+    flags |= LIS3MDL_FLAG_SATURATED;
+  return flags;
+}
+
+#ifndef LIS3MDL_NO_FLOAT
+/**************************************************************************/
+/*!
+    @brief  Gets the most recent sensor event, Adafruit Unified Sensor format.
+    The sample's LIS3MDL_FLAG_* bits are stored in event->reserved0.
     @param  event Pointer to an Adafruit Unified sensor_event_t object that
    we'll fill in
     @returns True on successful read
 */
 /**************************************************************************/
 bool Adafruit_LIS3MDL::getEvent(sensors_event_t *event) {
-  /* Clear the event */
-  memset(event, 0, sizeof(sensors_event_t));
+  // STATUS comes in the same burst, for the flags
+  lis3mdl_sample_t sample;
+  if (!readSample(&sample))
+    return false;
 
-  event->version = sizeof(sensors_event_t);
-  event->sensor_id = _sensorID;
-  event->type = SENSOR_TYPE_MAGNETIC_FIELD;
-  event->timestamp = millis();
+  float scale = lis3mdl_rangeToLSBPerGauss(rangeBuffered);
+  x_gauss = (float)x / scale;
+  y_gauss = (float)y / scale;
+  z_gauss = (float)z / scale;
 
-  read();
+  getEvents(event, &sample, 1);
+  return true;
+}
 
-  event->magnetic.x = x_gauss * 100; // microTesla per gauss
-  event->magnetic.y = y_gauss * 100; // microTesla per gauss
-  event->magnetic.z = z_gauss * 100; // microTesla per gauss
+/**************************************************************************/
+/*!
+    @brief  Convert a block of samples that were already read, for example
+    by an Adafruit_LIS3MDL_Array or a batch reader, into Unified Sensor
+    events. The header fields come from one template instead of a memset
+    per event, and the scale is looked up once for the block. No bus
+    traffic is done.
+    @param  events Where to store n events
+    @param  samples The samples, taken at the current range
+    @param  n Number of samples
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL::getEvents(sensors_event_t *events,
+                                 const lis3mdl_sample_t *samples, size_t n) {
+  sensors_event_t header;
 
-  return true;
+  memset(&header, 0, sizeof(header));
+  header.version = sizeof(sensors_event_t);
+  header.sensor_id = _sensorID;
+  header.type = SENSOR_TYPE_MAGNETIC_FIELD;
+
+  // microTesla per count
+  float scale = 100.0f / lis3mdl_rangeToLSBPerGauss(rangeBuffered);
+
+  for (size_t i = 0; i < n; i++) {
+    sensors_event_t *event = &events[i];
+    *event = header;
+    event->timestamp = samples[i].timestamp;
+    event->reserved0 = samples[i].flags;
+    event->magnetic.x = samples[i].x * scale;
+    event->magnetic.y = samples[i].y * scale;
+    event->magnetic.z = samples[i].z * scale;
+  }
 }
 
 /**************************************************************************/
 /*!
-    @brief  Gets the sensor_t device data, Adafruit Unified Sensor format
+    @brief  Gets the sensor_t device data, Adafruit Unified Sensor format.
+    The limits and resolution are those of the range last set or read.
     @param  sensor Pointer to an Adafruit Unified sensor_t object that we'll
    fill in
 */
@@ -244,10 +657,14 @@ void Adafruit_LIS3MDL::getSensor(sensor_t *sensor) {
   sensor->sensor_id = _sensorID;
   sensor->type = SENSOR_TYPE_MAGNETIC_FIELD;
   sensor->min_delay = 0;
-  sensor->min_value = -1600;  // -16 gauss in uTesla
-  sensor->max_value = 1600;   // +16 gauss in uTesla
-  sensor->resolution = 0.015; // 100/6842 uTesla per LSB at +-4 gauss range
+
+  // From the cached range, so no bus traffic
+  float fullScale = 400.0f * (rangeBuffered + 1); // uTesla
+  sensor->min_value = -fullScale;
+  sensor->max_value = fullScale;
+  sensor->resolution = 100.0f / lis3mdl_rangeToLSBPerGauss(rangeBuffered);
 }
+#endif
 
 /**************************************************************************/
 /*!
@@ -272,6 +689,7 @@ void Adafruit_LIS3MDL::setPerformanceMode(lis3mdl_performancemode_t mode) {
   Adafruit_BusIO_RegisterBits performancemodezbits =
       Adafruit_BusIO_RegisterBits(&CTRL_REG4, 2, 2);
   performancemodezbits.write((uint8_t)mode);
+  _settling = LIS3MDL_SETTLE_SAMPLES;
 }
 
 /**************************************************************************/
@@ -295,9 +713,16 @@ lis3mdl_performancemode_t Adafruit_LIS3MDL::getPerformanceMode(void) {
     @brief  Sets the data rate for the LIS3MDL (controls power consumption)
     from 0.625 Hz to 80Hz
     @param dataRate Enumerated lis3mdl_dataRate_t
+    @returns False if the rate is over the limit set with setRateLimit(); it
+    was then lowered to the limit, or applied anyway if clamping is off
 */
 /**************************************************************************/
-void Adafruit_LIS3MDL::setDataRate(lis3mdl_dataRate_t dataRate) {
+bool Adafruit_LIS3MDL::setDataRate(lis3mdl_dataRate_t dataRate) {
+  bool withinLimit =
+      !_maxRate_mHz || lis3mdl_dataRateToMilliHz(dataRate) <= _maxRate_mHz;
+  if (!withinLimit && _clampRate)
+    dataRate = lis3mdl_fastestDataRate(_maxRate_mHz);
+
   if (dataRate == LIS3MDL_DATARATE_155_HZ) {
     // set OP to UHP
     setPerformanceMode(LIS3MDL_ULTRAHIGHMODE);
@@ -321,6 +746,22 @@ void Adafruit_LIS3MDL::setDataRate(lis3mdl_dataRate_t dataRate) {
   Adafruit_BusIO_RegisterBits dataratebits =
       Adafruit_BusIO_RegisterBits(&CTRL_REG1, 4, 1); // includes FAST_ODR
   dataratebits.write((uint8_t)dataRate);
+  _settling = LIS3MDL_SETTLE_SAMPLES;
+  return withinLimit;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Cap the data rate setDataRate() accepts, for example at the
+    maxRate_mHz from lis3mdl_planBus()
+    @param maxRate_mHz Highest sustainable rate in mHz, 0 to remove the cap
+    @param clamp True to lower faster requests to the fastest rate within
+    the cap, false to apply them anyway and only report them
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL::setRateLimit(uint32_t maxRate_mHz, bool clamp) {
+  _maxRate_mHz = maxRate_mHz;
+  _clampRate = clamp;
 }
 
 /**************************************************************************/
@@ -350,9 +791,14 @@ void Adafruit_LIS3MDL::setOperationMode(lis3mdl_operationmode_t mode) {
   Adafruit_BusIO_Register CTRL_REG3 =
       Adafruit_BusIO_Register(i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC,
                               LIS3MDL_REG_CTRL_REG3, 1);
-  Adafruit_BusIO_RegisterBits opmodebits =
-      Adafruit_BusIO_RegisterBits(&CTRL_REG3, 2, 0);
-  opmodebits.write((uint8_t)mode);
+  uint8_t ctrl3 = CTRL_REG3.read();
+  CTRL_REG3.write((ctrl3 & ~0x03) | (uint8_t)mode);
+
+  // Starting continuous conversions restarts the output rate. A
+  // single-shot trigger is one fresh conversion and is not flagged.
+  if (mode == LIS3MDL_CONTINUOUSMODE &&
+      (ctrl3 & 0x03) != LIS3MDL_CONTINUOUSMODE)
+    _settling = LIS3MDL_SETTLE_SAMPLES;
 }
 
 /**************************************************************************/
@@ -371,6 +817,38 @@ lis3mdl_operationmode_t Adafruit_LIS3MDL::getOperationMode(void) {
   return (lis3mdl_operationmode_t)opmodebits.read();
 }
 
+/**************************************************************************/
+/*!
+    @brief Set the LP bit. While it is set the data rate is 0.625 Hz and
+    each conversion uses the fewest averages, whatever DO and OM say.
+    @param enable True for low-power mode
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL::setLowPower(bool enable) {
+  Adafruit_BusIO_Register CTRL_REG3 =
+      Adafruit_BusIO_Register(i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC,
+                              LIS3MDL_REG_CTRL_REG3, 1);
+  Adafruit_BusIO_RegisterBits lpbit =
+      Adafruit_BusIO_RegisterBits(&CTRL_REG3, 1, 5);
+  lpbit.write(enable);
+  _settling = LIS3MDL_SETTLE_SAMPLES;
+}
+
+/**************************************************************************/
+/*!
+    @brief Get the LP bit
+    @returns True if low-power mode is on
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL::getLowPower(void) {
+  Adafruit_BusIO_Register CTRL_REG3 =
+      Adafruit_BusIO_Register(i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC,
+                              LIS3MDL_REG_CTRL_REG3, 1);
+  Adafruit_BusIO_RegisterBits lpbit =
+      Adafruit_BusIO_RegisterBits(&CTRL_REG3, 1, 5);
+  return lpbit.read();
+}
+
 /**************************************************************************/
 /*!
     @brief Set the resolution range: +-4 gauss, 8 gauss, 12 gauss, or 16 gauss.
@@ -386,6 +864,7 @@ void Adafruit_LIS3MDL::setRange(lis3mdl_range_t range) {
   rangebits.write((uint8_t)range);
 
   rangeBuffered = range;
+  _settling = LIS3MDL_SETTLE_SAMPLES;
 }
 
 /**************************************************************************/
@@ -477,11 +956,290 @@ void Adafruit_LIS3MDL::selfTest(bool flag) {
       Adafruit_BusIO_RegisterBits(&CTRL_REG1, 1, 0);
 
   stbit.write(flag);
+  _selfTest = flag;
+  _settling = LIS3MDL_SETTLE_SAMPLES;
+}
+
+/**************************************************************************/
+/*!
+    @brief Average fresh samples, polling ZYXDA rather than waiting fixed
+    times. The first conversion after a settings change is discarded.
+    @param average Where to store the X/Y/Z averages in raw counts
+    @param samples Number of samples to average
+    @returns False if data-ready did not come within 50 ms of a sample
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL::averageSamples(int16_t average[3], uint8_t samples) {
+  int32_t sum[3] = {0, 0, 0};
+  lis3mdl_sample_t sample;
+
+  for (int16_t i = -1; i < samples; i++) {
+    uint32_t start = millis();
+    do {
+      if (!readSample(&sample) || millis() - start > 50)
+        return false;
+    } while (!(sample.status & 0x08)); // ZYXDA
+    if (i < 0)
+      continue;
+    sum[0] += sample.x;
+    sum[1] += sample.y;
+    sum[2] += sample.z;
+  }
+  for (uint8_t a = 0; a < 3; a++)
+    average[a] = sum[a] / samples;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Run the datasheet self-test: average samples at 12 gauss and 80
+    Hz with the self-test coil off, then on, and check the change on each
+    axis against the limits (1 to 3 gauss on X and Y, 0.1 to 1 gauss on Z).
+    Data-ready is polled instead of waiting fixed times, so the test takes
+    about 2 * (samples + 1) conversions. The control registers are restored
+    afterwards.
+    @param result Where to store the averages, per-axis verdicts and gains.
+    The gains scale each axis so its self-test response lands on the middle
+    of the limits; the coil field varies by part, so treat them as a coarse
+    sensitivity trim rather than a calibration.
+    @param samples Number of samples to average in each state, at least 1
+    @returns True if every axis passed
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL::runSelfTest(lis3mdl_selftest_t *result,
+                                   uint8_t samples) {
+  // Limits and nominal response in counts at 12 gauss (2281 LSB/gauss)
+  static const int16_t minDelta[3] = {2281, 2281, 228};
+  static const int16_t maxDelta[3] = {6843, 6843, 2281};
+#ifndef LIS3MDL_NO_FLOAT
+  static const float nominal[3] = {4562, 4562, 1255};
+#endif
+  // 80 Hz, 12 gauss, continuous, low power mode on all axes
+  uint8_t testRegs[5] = {0x1C, 0x40, 0x00, 0x00, 0x00};
+  uint8_t saved[5], ctrl1;
+  bool ok;
+
+  memset(result, 0, sizeof(*result));
+  if (!samples)
+    samples = 1;
+
+  Adafruit_BusIO_Register CTRL_REGS =
+      Adafruit_BusIO_Register(i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC,
+                              LIS3MDL_REG_CTRL_REG1, 5);
+  Adafruit_BusIO_Register CTRL_REG1 =
+      Adafruit_BusIO_Register(i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC,
+                              LIS3MDL_REG_CTRL_REG1, 1);
+  if (!CTRL_REGS.read(saved, 5) || !CTRL_REGS.write(testRegs, 5))
+    return false;
+
+  ok = averageSamples(result->off, samples);
+  ctrl1 = testRegs[0] | 0x01; // ST
+  ok = ok && CTRL_REG1.write(&ctrl1, 1) && averageSamples(result->on, samples);
+  writeRegisters(LIS3MDL_REG_CTRL_REG1, saved, 5); // flags settling
+
+  if (!ok)
+    return false;
+
+  bool pass = true;
+  for (uint8_t a = 0; a < 3; a++) {
+    result->delta[a] = result->on[a] - result->off[a];
+    result->pass[a] =
+        result->delta[a] >= minDelta[a] && result->delta[a] <= maxDelta[a];
+#ifndef LIS3MDL_NO_FLOAT
+    result->gain[a] = result->delta[a] > 0 ? nominal[a] / result->delta[a] : 0;
+#endif
+    pass = pass && result->pass[a];
+  }
+  return pass;
+}
+
+/**************************************************************************/
+/*!
+    @brief Read back the settings that determine current consumption. CTRL_REG1
+    through CTRL_REG4 are fetched in a single burst.
+    @param config Pointer to a lis3mdl_power_config_t to fill in. dataRate is
+    the rate the part runs at: with FAST_ODR set it follows the X/Y
+    performance mode, and with LP set it is 0.625 Hz. The
+    singleShotRate_mHz member is left untouched since it is not a register.
+    @returns False if the read failed; config is then unchanged
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL::getPowerConfig(lis3mdl_power_config_t *config) {
+  uint8_t buffer[4];
+
+  Adafruit_BusIO_Register CTRL_REGS =
+      Adafruit_BusIO_Register(i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC,
+                              LIS3MDL_REG_CTRL_REG1, 4);
+  if (!CTRL_REGS.read(buffer, 4))
+    return false;
+
+  config->performanceMode =
+      (lis3mdl_performancemode_t)((buffer[0] >> 5) & 0x3);
+  config->dataRate = lis3mdl_effectiveDataRate(buffer[0], buffer[2]);
+  config->lowPower = buffer[2] & 0x20;
+  config->operationMode = (lis3mdl_operationmode_t)(buffer[2] & 0x3);
+  config->performanceModeZ =
+      (lis3mdl_performancemode_t)((buffer[3] >> 2) & 0x3);
+  if (config->operationMode == 0b10) // both power-down encodings
+    config->operationMode = LIS3MDL_POWERDOWNMODE;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Apply a power configuration, for example one returned by
+    lis3mdl_planPower(). Unlike setPerformanceMode(), X/Y and Z modes are
+    written independently.
+    @param config Pointer to the configuration to apply
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL::setPowerConfig(const lis3mdl_power_config_t *config) {
+  Adafruit_BusIO_Register CTRL_REG1 =
+      Adafruit_BusIO_Register(i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC,
+                              LIS3MDL_REG_CTRL_REG1, 1);
+  Adafruit_BusIO_RegisterBits omrateBits =
+      Adafruit_BusIO_RegisterBits(&CTRL_REG1, 6, 1); // OM, DO and FAST_ODR
+  omrateBits.write(((uint8_t)config->performanceMode << 4) |
+                   (uint8_t)config->dataRate);
+
+  Adafruit_BusIO_Register CTRL_REG4 =
+      Adafruit_BusIO_Register(i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC,
+                              LIS3MDL_REG_CTRL_REG4, 1);
+  Adafruit_BusIO_RegisterBits omzBits =
+      Adafruit_BusIO_RegisterBits(&CTRL_REG4, 2, 2);
+  omzBits.write((uint8_t)config->performanceModeZ);
+
+  // LP and MD are written last so a single-shot conversion starts with the
+  // new settings
+  Adafruit_BusIO_Register CTRL_REG3 =
+      Adafruit_BusIO_Register(i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC,
+                              LIS3MDL_REG_CTRL_REG3, 1);
+  uint8_t ctrl3 = CTRL_REG3.read() & ~0x23;
+  if (config->lowPower)
+    ctrl3 |= 0x20;
+  ctrl3 |= (uint8_t)config->operationMode;
+  CTRL_REG3.write(ctrl3);
+  _settling = LIS3MDL_SETTLE_SAMPLES;
 }
 
 /**************************************************************************/
 /*!
-    @brief Get the magnetic data rate.
+    @brief Estimate the average supply current of the current configuration
+    @param singleShotRate_mHz How often single-shot conversions are triggered,
+    only used when the sensor is in LIS3MDL_SINGLEMODE
+    @returns Estimated average current in nA, 0 if the sensor did not respond
+*/
+/**************************************************************************/
+uint32_t Adafruit_LIS3MDL::estimateCurrent(uint32_t singleShotRate_mHz) {
+  lis3mdl_power_config_t config;
+  if (!getPowerConfig(&config))
+    return 0;
+  config.singleShotRate_mHz = singleShotRate_mHz;
+  return lis3mdl_estimateCurrent(&config);
+}
+
+/**************************************************************************/
+/*!
+    @brief Fastest data rate setting that does not exceed a rate
+    @param maxRate_mHz Rate limit in mHz
+    @returns The fastest setting at or below the limit, or 0.625 Hz if the
+    limit is below every setting
+*/
+/**************************************************************************/
+lis3mdl_dataRate_t lis3mdl_fastestDataRate(uint32_t maxRate_mHz) {
+  lis3mdl_dataRate_t best = LIS3MDL_DATARATE_0_625_HZ;
+
+  for (uint8_t i = 0; i < 16; i++) {
+    uint32_t rate = lis3mdl_dataRateToMilliHz((lis3mdl_dataRate_t)i);
+    if (rate && rate <= maxRate_mHz &&
+        rate > lis3mdl_dataRateToMilliHz(best))
+      best = (lis3mdl_dataRate_t)i;
+  }
+  return best;
+}
+
+/**************************************************************************/
+/*!
+    @brief Sensitivity for a range setting
+    @param range Enumerated lis3mdl_range_t
+    @returns LSB per gauss, from the datasheet
+*/
+/**************************************************************************/
+uint16_t lis3mdl_rangeToLSBPerGauss(lis3mdl_range_t range) {
+  switch (range) {
+  case LIS3MDL_RANGE_16_GAUSS:
+    return 1711;
+  case LIS3MDL_RANGE_12_GAUSS:
+    return 2281;
+  case LIS3MDL_RANGE_8_GAUSS:
+    return 3421;
+  case LIS3MDL_RANGE_4_GAUSS:
+    return 6842;
+  }
+
+  return 1;
+}
+
+/**************************************************************************/
+/*!
+    @brief Convert raw counts to nanotesla without floating point. The
+    scale is nanotesla per count in Q8, which is within 0.02% of the
+    datasheet sensitivity in every range.
+    @param counts Raw reading
+    @param range Enumerated lis3mdl_range_t the reading was taken at
+    @returns The field in nT, 1 gauss being 100000 nT
+*/
+/**************************************************************************/
+int32_t lis3mdl_countsToNanoTesla(int16_t counts, lis3mdl_range_t range) {
+  // 25600000 / LSB per gauss, indexed by lis3mdl_range_t
+  static const uint16_t nanoTeslaQ8[4] = {3742, 7483, 11223, 14962};
+
+  return ((int32_t)counts * nanoTeslaQ8[range & 0x03] + 128) >> 8;
+}
+
+/**************************************************************************/
+/*!
+    @brief Convert a data rate setting to its frequency
+    @param dataRate Enumerated lis3mdl_dataRate_t
+    @returns The data rate in mHz
+*/
+/**************************************************************************/
+uint32_t lis3mdl_dataRateToMilliHz(lis3mdl_dataRate_t dataRate) {
+  switch (dataRate) {
+  case LIS3MDL_DATARATE_0_625_HZ:
+    return 625;
+  case LIS3MDL_DATARATE_1_25_HZ:
+    return 1250;
+  case LIS3MDL_DATARATE_2_5_HZ:
+    return 2500;
+  case LIS3MDL_DATARATE_5_HZ:
+    return 5000;
+  case LIS3MDL_DATARATE_10_HZ:
+    return 10000;
+  case LIS3MDL_DATARATE_20_HZ:
+    return 20000;
+  case LIS3MDL_DATARATE_40_HZ:
+    return 40000;
+  case LIS3MDL_DATARATE_80_HZ:
+    return 80000;
+  case LIS3MDL_DATARATE_155_HZ:
+    return 155000;
+  case LIS3MDL_DATARATE_300_HZ:
+    return 300000;
+  case LIS3MDL_DATARATE_560_HZ:
+    return 560000;
+  case LIS3MDL_DATARATE_1000_HZ:
+    return 1000000;
+  }
+
+  return 0;
+}
+
+#ifndef LIS3MDL_NO_FLOAT
+/**************************************************************************/
+/*!
+    @brief Get the magnetic data rate. Without floating point, use
+    lis3mdl_dataRateToMilliHz(getDataRate()) instead.
     @returns The data rate in float
 */
 float Adafruit_LIS3MDL::magneticFieldSampleRate(void) {
@@ -514,6 +1272,7 @@ float Adafruit_LIS3MDL::magneticFieldSampleRate(void) {
 
   return 0;
 }
+#endif
 
 /**************************************************************************/
 /*!
@@ -526,6 +1285,7 @@ int Adafruit_LIS3MDL::magneticFieldAvailable(void) {
   return (REG_STATUS.read() & 0x08) ? 1 : 0;
 }
 
+#ifndef LIS3MDL_NO_FLOAT
 /**************************************************************************/
 /*!
     @brief Read magnetic data
@@ -551,3 +1311,34 @@ int Adafruit_LIS3MDL::readMagneticField(float &x, float &y, float &z) {
 
   return 1;
 }
+#endif
+
+/**************************************************************************/
+/*!
+    @brief Read magnetic data without floating point
+    @param x reference to x axis, in nanotesla at the current range
+    @param y reference to y axis, in nanotesla at the current range
+    @param z reference to z axis, in nanotesla at the current range
+    @returns 1 if success, 0 if not
+*/
+int Adafruit_LIS3MDL::readMagneticField(int32_t &x, int32_t &y, int32_t &z) {
+  uint8_t buffer[6];
+
+  Adafruit_BusIO_Register XYZDataReg = Adafruit_BusIO_Register(
+      i2c_dev, spi_dev, AD8_HIGH_TOREAD_AD7_HIGH_TOINC, LIS3MDL_REG_OUT_X_L, 6);
+
+  if (!XYZDataReg.read(buffer, 6)) {
+    x = y = z = 0;
+    return 0;
+  }
+
+  // The part sends each axis low byte first
+  x = lis3mdl_countsToNanoTesla((int16_t)(buffer[0] | (buffer[1] << 8)),
+                                rangeBuffered);
+  y = lis3mdl_countsToNanoTesla((int16_t)(buffer[2] | (buffer[3] << 8)),
+                                rangeBuffered);
+  z = lis3mdl_countsToNanoTesla((int16_t)(buffer[4] | (buffer[5] << 8)),
+                                rangeBuffered);
+
+  return 1;
+}
@@ -1,6 +1,12 @@
 /*!
  * @file     Adafruit_LIS3MDL.h
  *
+ * Define LIS3MDL_NO_FLOAT (for example with -DLIS3MDL_NO_FLOAT in the build
+ * flags) for an integer-only driver on parts without an FPU. The gauss
+ * members, the Unified Sensor interface and the float Arduino API are
+ * compiled out; readings are available as raw counts or as nanotesla from
+ * lis3mdl_countsToNanoTesla() and the int32_t readMagneticField().
+ *
  */
 
 #ifndef ADAFRUIT_LIS3MDL_H
@@ -18,15 +24,18 @@ I2C ADDRESS/BITS
 #define LIS3MDL_I2CADDR_DEFAULT (0x1C) ///< Default breakout addres
 /*=========================================================================*/
 
-#define LIS3MDL_REG_WHO_AM_I 0x0F  ///< Register that contains the part ID
-#define LIS3MDL_REG_CTRL_REG1 0x20 ///< Register address for control 1
-#define LIS3MDL_REG_CTRL_REG2 0x21 ///< Register address for control 2
-#define LIS3MDL_REG_CTRL_REG3 0x22 ///< Register address for control 3
-#define LIS3MDL_REG_CTRL_REG4 0x23 ///< Register address for control 3
-#define LIS3MDL_REG_STATUS 0x27    ///< Register address for status
-#define LIS3MDL_REG_OUT_X_L 0x28   ///< Register address for X axis lower byte
-#define LIS3MDL_REG_INT_CFG 0x30   ///< Interrupt configuration register
-#define LIS3MDL_REG_INT_THS_L 0x32 ///< Low byte of the irq threshold
+#define LIS3MDL_REG_WHO_AM_I 0x0F   ///< Register that contains the part ID
+#define LIS3MDL_REG_CTRL_REG1 0x20  ///< Register address for control 1
+#define LIS3MDL_REG_CTRL_REG2 0x21  ///< Register address for control 2
+#define LIS3MDL_REG_CTRL_REG3 0x22  ///< Register address for control 3
+#define LIS3MDL_REG_CTRL_REG4 0x23  ///< Register address for control 3
+#define LIS3MDL_REG_CTRL_REG5 0x24  ///< Register address for control 5
+#define LIS3MDL_REG_STATUS 0x27     ///< Register address for status
+#define LIS3MDL_REG_OUT_X_L 0x28    ///< Register address for X axis lower byte
+#define LIS3MDL_REG_TEMP_OUT_L 0x2E ///< Low byte of the temperature
+#define LIS3MDL_REG_INT_CFG 0x30    ///< Interrupt configuration register
+#define LIS3MDL_REG_INT_SRC 0x31    ///< Interrupt source register
+#define LIS3MDL_REG_INT_THS_L 0x32  ///< Low byte of the irq threshold
 
 /** The magnetometer ranges */
 typedef enum {
@@ -67,8 +76,114 @@ typedef enum {
   LIS3MDL_POWERDOWNMODE = 0b11,  ///< Powered-down mode
 } lis3mdl_operationmode_t;
 
+/** Settings that determine the current consumption, from CTRL_REG1/3/4 */
+typedef struct {
+  lis3mdl_operationmode_t operationMode;      ///< MD bits
+  lis3mdl_performancemode_t performanceMode;  ///< OM bits (X and Y)
+  lis3mdl_performancemode_t performanceModeZ; ///< OMZ bits (Z)
+  lis3mdl_dataRate_t dataRate;                ///< DO and FAST_ODR bits
+  bool lowPower;                              ///< LP bit
+  uint32_t singleShotRate_mHz;                ///< Single-shot trigger rate
+} lis3mdl_power_config_t;
+
+#define LIS3MDL_FLAG_STALE 0x01     ///< No new data since the last read
+#define LIS3MDL_FLAG_OVERRUN 0x02   ///< Data was overwritten before reading
+#define LIS3MDL_FLAG_SATURATED 0x04 ///< An axis is at the end of its range
+#define LIS3MDL_FLAG_SETTLING 0x08  ///< Taken right after a settings change
+#define LIS3MDL_FLAG_SELFTEST 0x10  ///< Taken with the self-test coil on
+
+#define LIS3MDL_AXIS_X 0x01   ///< X axis, same bit as XDA in STATUS
+#define LIS3MDL_AXIS_Y 0x02   ///< Y axis, same bit as YDA in STATUS
+#define LIS3MDL_AXIS_Z 0x04   ///< Z axis, same bit as ZDA in STATUS
+#define LIS3MDL_AXIS_XYZ 0x07 ///< All three axes
+
+/** Counts at or beyond which an axis is saturated, in every range */
+#define LIS3MDL_SATURATION_COUNTS 27344
+
+#ifndef LIS3MDL_SETTLE_SAMPLES
+/** New samples flagged as settling after a settings change */
+#define LIS3MDL_SETTLE_SAMPLES 2
+#endif
+
+/** One STATUS + XYZ reading, as fetched by a single burst */
+typedef struct {
+  int16_t x;          ///< X axis in raw units
+  int16_t y;          ///< Y axis in raw units
+  int16_t z;          ///< Z axis in raw units
+  uint8_t status;     ///< STATUS_REG at the time of the read
+  uint8_t flags;      ///< LIS3MDL_FLAG_* quality bits
+  uint32_t timestamp; ///< millis() when the burst completed
+} lis3mdl_sample_t;
+
+/** Result of Adafruit_LIS3MDL::runSelfTest() */
+typedef struct {
+  int16_t off[3];   ///< Average X/Y/Z with ST off, raw counts at 12 gauss
+  int16_t on[3];    ///< Average X/Y/Z with ST on, raw counts at 12 gauss
+  int16_t delta[3]; ///< on - off per axis
+  bool pass[3];     ///< delta inside the datasheet limits for the axis
+#ifndef LIS3MDL_NO_FLOAT
+  float gain[3]; ///< Nominal / measured delta, to multiply readings by
+#endif
+} lis3mdl_selftest_t;
+
+#define LIS3MDL_DUMP_FIRST 0x20 ///< First register of the main dump burst
+#define LIS3MDL_DUMP_LENGTH 20  ///< CTRL_REG1 (0x20) through INT_THS_H (0x33)
+
+/** Diff bit for a dumped register: WHO_AM_I is bit 0, 0x20..0x33 bits 1-20 */
+#define LIS3MDL_DUMP_BIT(reg)                                                  \
+  ((reg) == LIS3MDL_REG_WHO_AM_I ? 1UL : 1UL << ((reg)-LIS3MDL_DUMP_FIRST + 1))
+/** Diff bits of the configuration: WHO_AM_I, CTRL_REG1-5, INT_CFG, INT_THS */
+#define LIS3MDL_DUMP_CONFIG 0x1A003FUL
+
+/** Raw register snapshot from Adafruit_LIS3MDL::dumpRegisters() */
+typedef struct {
+  uint8_t whoAmI;                    ///< WHO_AM_I (0x0F)
+  uint8_t regs[LIS3MDL_DUMP_LENGTH]; ///< 0x20..0x33, by reg - 0x20
+} lis3mdl_registers_t;
+
+/** A register snapshot decoded into settings and readings */
+typedef struct {
+  lis3mdl_range_t range;                      ///< Full scale
+  lis3mdl_dataRate_t dataRate;                ///< Effective output rate
+  lis3mdl_performancemode_t performanceMode;  ///< X/Y performance mode
+  lis3mdl_performancemode_t performanceModeZ; ///< Z performance mode
+  lis3mdl_operationmode_t operationMode;      ///< Continuous, single, off
+  bool lowPower;                              ///< LP bit
+  bool selfTest;                              ///< ST bit
+  bool temperature;                           ///< TEMP_EN bit
+  bool fastRead;                              ///< FAST_READ bit
+  bool blockDataUpdate;                       ///< BDU bit
+  bool bigEndian;                             ///< BLE bit
+  bool spi3Wire;                              ///< SIM bit
+  uint8_t intAxes;                            ///< Axes enabled, LIS3MDL_AXIS_*
+  bool intActiveHigh;                         ///< IEA bit
+  bool intLatched;                            ///< LIR bit
+  bool intEnabled;                            ///< IEN bit
+  uint16_t intThreshold;                      ///< INT_THS, unsigned counts
+  uint8_t intSource;                          ///< INT_SRC when dumped
+  uint8_t status;                             ///< STATUS_REG when dumped
+  int16_t out[3];                             ///< X/Y/Z when dumped, raw counts
+  int16_t tempOut;                            ///< TEMP_OUT, 8 LSB/C from 25 C
+} lis3mdl_decoded_t;
+
+uint32_t lis3mdl_dataRateToMilliHz(lis3mdl_dataRate_t dataRate);
+lis3mdl_dataRate_t lis3mdl_fastestDataRate(uint32_t maxRate_mHz);
+uint16_t lis3mdl_rangeToLSBPerGauss(lis3mdl_range_t range);
+int32_t lis3mdl_countsToNanoTesla(int16_t counts, lis3mdl_range_t range);
+void lis3mdl_unpackSample(const uint8_t *buffer, lis3mdl_sample_t *sample);
+uint8_t lis3mdl_sampleFlags(const lis3mdl_sample_t *sample);
+void lis3mdl_decodeRegisters(const lis3mdl_registers_t *dump,
+                             lis3mdl_decoded_t *decoded);
+uint32_t lis3mdl_diffRegisters(const lis3mdl_registers_t *actual,
+                               const lis3mdl_registers_t *expected,
+                               uint32_t mask = LIS3MDL_DUMP_CONFIG);
+
 /** Class for hardware interfacing with an LIS3MDL magnetometer */
+#ifndef LIS3MDL_NO_FLOAT
 class Adafruit_LIS3MDL : public Adafruit_Sensor {
+#else
+class Adafruit_LIS3MDL {
+#endif
 public:
   Adafruit_LIS3MDL(void);
   bool begin_I2C(uint8_t i2c_addr = LIS3MDL_I2CADDR_DEFAULT,
@@ -79,12 +194,19 @@ public:
                  int8_t mosi_pin, uint32_t frequency = 1000000);
 
   void reset(void);
+  uint32_t negotiateBusSpeed(uint32_t maxFrequency = 0);
+  bool readRegisters(uint8_t reg, uint8_t *buffer, uint8_t len);
+  bool writeRegisters(uint8_t reg, uint8_t *buffer, uint8_t len);
+  bool dumpRegisters(lis3mdl_registers_t *dump);
 
   void setPerformanceMode(lis3mdl_performancemode_t mode);
   lis3mdl_performancemode_t getPerformanceMode(void);
   void setOperationMode(lis3mdl_operationmode_t mode);
   lis3mdl_operationmode_t getOperationMode(void);
-  void setDataRate(lis3mdl_dataRate_t dataRate);
+  void setLowPower(bool enable);
+  bool getLowPower(void);
+  bool setDataRate(lis3mdl_dataRate_t dataRate);
+  void setRateLimit(uint32_t maxRate_mHz, bool clamp = true);
   lis3mdl_dataRate_t getDataRate(void);
   void setRange(lis3mdl_range_t range);
   lis3mdl_range_t getRange(void);
@@ -93,33 +215,61 @@ public:
   void configInterrupt(bool enableX, bool enableY, bool enableZ, bool polarity,
                        bool latch, bool enableInt);
   void selfTest(bool flag);
+  bool runSelfTest(lis3mdl_selftest_t *result, uint8_t samples = 5);
+
+  bool getPowerConfig(lis3mdl_power_config_t *config);
+  void setPowerConfig(const lis3mdl_power_config_t *config);
+  uint32_t estimateCurrent(uint32_t singleShotRate_mHz = 0);
 
   void read();
+  bool readSample(lis3mdl_sample_t *sample);
+  bool readAxes(uint8_t axes, int16_t data[3]);
+  uint8_t axesAvailable(uint8_t axes = LIS3MDL_AXIS_XYZ);
+#ifndef LIS3MDL_NO_FLOAT
   bool getEvent(sensors_event_t *event);
+  void getEvents(sensors_event_t *events, const lis3mdl_sample_t *samples,
+                 size_t n);
   void getSensor(sensor_t *sensor);
+#endif
 
   // Arduino compatible API
+#ifndef LIS3MDL_NO_FLOAT
   int readMagneticField(float &x, float &y, float &z);
   float magneticFieldSampleRate(void);
+#endif
+  int readMagneticField(int32_t &x, int32_t &y, int32_t &z);
   int magneticFieldAvailable(void);
 
-  int16_t x,     ///< The last read X mag in raw units
-      y,         ///< The last read Y mag in raw units
-      z;         ///< The last read Z mag in raw units
+  int16_t x, ///< The last read X mag in raw units
+      y,     ///< The last read Y mag in raw units
+      z;     ///< The last read Z mag in raw units
+#ifndef LIS3MDL_NO_FLOAT
   float x_gauss, ///< The last read X mag in 'gauss'
       y_gauss,   ///< The last read Y mag in 'gauss'
       z_gauss;   ///< The last read Z mag in 'gauss'
+#endif
 
   //! buffer for the magnetometer range
   lis3mdl_range_t rangeBuffered = LIS3MDL_RANGE_4_GAUSS;
 
+protected:
+  int32_t _sensorID; ///< Unified Sensor ID reported in events
+
 private:
   bool _init(void);
+  bool averageSamples(int16_t average[3], uint8_t samples);
+  bool setBusSpeed(uint32_t frequency);
+  bool probeBus(void);
 
   Adafruit_I2CDevice *i2c_dev = NULL;
   Adafruit_SPIDevice *spi_dev = NULL;
-
-  int32_t _sensorID;
+  SPIClass *_spi = NULL; // hardware SPI bus, NULL for I2C or software SPI
+  uint8_t _cs = 0;
+  uint32_t _frequency = 0;   // I2C or hardware SPI clock in use
+  uint32_t _maxRate_mHz = 0; // 0 for no limit
+  bool _clampRate = true;
+  uint8_t _settling = 0; // fresh samples still flagged as settling
+  bool _selfTest = false;
 };
 
 #endif
@@ -0,0 +1,277 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Aligner.cpp
+ *
+ * Every LIS3MDL samples on its own oscillator, so the streams of several
+ * sensors drift against each other and against the host clock, and host
+ * timestamps carry polling jitter on top. For each sensor the aligner runs
+ * an alpha-beta tracker on the arrival times: it predicts when the next
+ * sample is due from the estimated phase and period, and corrects both by
+ * a fraction of the prediction error. Missed samples show up as whole
+ * multiples of the period and are skipped over.
+ *
+ * Samples are stored with their filtered times and linearly interpolated
+ * onto a common grid. A frame is released as soon as every sensor has a
+ * sample at or after its grid time, or once it is older than the latency
+ * bound, in which case sensors without data are marked invalid.
+ *
+ * All arithmetic is integer and all storage is fixed at compile time.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_Aligner.h"
+
+// A gap longer than this many periods restarts the tracker
+#define LIS3MDL_ALIGN_MAX_GAP 16
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates an aligner with no sensors
+*/
+/**************************************************************************/
+Adafruit_LIS3MDL_Aligner::Adafruit_LIS3MDL_Aligner(void) { begin(10000, 0); }
+
+/**************************************************************************/
+/*!
+    @brief  Set up the output grid and forget all sensors
+    @param  gridPeriod_us Time between frames
+    @param  maxLatency_us How long after its grid time a frame is released
+    even if some sensors have not caught up. Should be at least the slowest
+    sensor's sample period plus the polling delay.
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Aligner::begin(uint32_t gridPeriod_us,
+                                     uint32_t maxLatency_us) {
+  memset(_tracks, 0, sizeof(_tracks));
+  _sensors = 0;
+  _gridPeriod_us = gridPeriod_us ? gridPeriod_us : 1;
+  _maxLatency_us = maxLatency_us;
+  _next_us = 0;
+  _sequence = 0;
+  _started = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Register a sensor stream
+    @param  dataRate The sensor's configured data rate, used as the starting
+    estimate of its period
+    @returns The sensor's index for addSample(), or -1 if the aligner is full
+    or dataRate is not a valid lis3mdl_dataRate_t
+*/
+/**************************************************************************/
+int8_t Adafruit_LIS3MDL_Aligner::addSensor(lis3mdl_dataRate_t dataRate) {
+  if (_sensors >= LIS3MDL_ALIGN_MAX_SENSORS || _started)
+    return -1;
+
+  uint32_t rate_mHz = lis3mdl_dataRateToMilliHz(dataRate);
+  if (rate_mHz == 0)
+    return -1;
+
+  lis3mdl_align_track_t *track = &_tracks[_sensors];
+  // Period in us is 1e9 / mHz, kept in 1/256 us
+  track->nominal_q8 = (1000000000UL / rate_mHz) << 8;
+  track->period_q8 = track->nominal_q8;
+  return _sensors++;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Feed one new sample from a sensor
+    @param  sensor Index returned by addSensor()
+    @param  sample A new sample, normally one with ZYXDA set
+    @param  timestamp_us micros() taken as soon as the sample was read
+    @returns False if the sensor index is unknown
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_Aligner::addSample(uint8_t sensor,
+                                         const lis3mdl_sample_t *sample,
+                                         uint32_t timestamp_us) {
+  if (sensor >= _sensors)
+    return false;
+
+  lis3mdl_align_track_t *track = &_tracks[sensor];
+  int64_t period = track->period_q8;
+
+  if (track->count != 0) {
+    // Time since the last estimate, in us/256
+    int64_t elapsed = ((int64_t)(int32_t)(timestamp_us - track->phase_us)
+                       << 8) -
+                      track->phaseFrac;
+    int64_t steps = elapsed < 0 ? 1 : (elapsed + period / 2) / period;
+    if (steps < 1)
+      steps = 1;
+
+    if (steps > LIS3MDL_ALIGN_MAX_GAP || elapsed < -period) {
+      track->count = 0; // lost track, start over
+      track->stored = 0;
+    } else {
+      // Start fast, settle to alpha 1/8 and beta 1/128
+      int64_t alpha = track->count < 7 ? track->count + 1 : 8;
+      int64_t beta = alpha * alpha * 2;
+      int64_t error = elapsed - steps * period;
+      int64_t advance = steps * period + error / alpha;
+
+      period += error / steps / beta;
+      int64_t low = track->nominal_q8 - track->nominal_q8 / 8;
+      int64_t high = track->nominal_q8 + track->nominal_q8 / 8;
+      if (period < low)
+        period = low;
+      if (period > high)
+        period = high;
+      track->period_q8 = (uint32_t)period;
+
+      advance += track->phaseFrac;
+      track->phase_us += (uint32_t)(advance >> 8);
+      track->phaseFrac = (uint8_t)(advance & 0xFF);
+    }
+  }
+
+  if (track->count == 0) {
+    track->phase_us = timestamp_us;
+    track->phaseFrac = 0;
+  }
+
+  track->head = (track->head + 1) & (LIS3MDL_ALIGN_HISTORY - 1);
+  track->time[track->head] = track->phase_us + (track->phaseFrac >> 7);
+  track->value[track->head][0] = sample->x;
+  track->value[track->head][1] = sample->y;
+  track->value[track->head][2] = sample->z;
+  if (track->stored < LIS3MDL_ALIGN_HISTORY)
+    track->stored++;
+  track->count++;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Interpolate one sensor's reading at a given time
+    @param  track The sensor
+    @param  when_us The time wanted
+    @param  xyz Where to store the X/Y/Z values
+    @param  late Set to true if when_us has already dropped out of the
+    history, so waiting longer will not help
+    @returns True if xyz was filled in
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_Aligner::interpolate(const lis3mdl_align_track_t *track,
+                                           uint32_t when_us, int16_t *xyz,
+                                           bool *late) {
+  *late = false;
+  if (track->stored == 0 ||
+      (int32_t)(when_us - track->time[track->head]) > 0)
+    return false;
+
+  uint8_t newer = track->head;
+  for (uint8_t i = 0; i < track->stored; i++) {
+    uint8_t idx = (track->head - i) & (LIS3MDL_ALIGN_HISTORY - 1);
+    int32_t since = (int32_t)(when_us - track->time[idx]);
+    if (since >= 0) {
+      if (idx == newer || since == 0) {
+        xyz[0] = track->value[idx][0];
+        xyz[1] = track->value[idx][1];
+        xyz[2] = track->value[idx][2];
+        return true;
+      }
+      // Q14 weight of the newer sample; the products fit in 32 bits
+      uint32_t span = track->time[newer] - track->time[idx];
+      int32_t weight = (int32_t)(((uint64_t)since << 14) / span);
+      for (uint8_t axis = 0; axis < 3; axis++) {
+        int32_t a = track->value[idx][axis];
+        int32_t b = track->value[newer][axis];
+        xyz[axis] = (int16_t)(a + (((b - a) * weight + 8192) >> 14));
+      }
+      return true;
+    }
+    newer = idx;
+  }
+
+  *late = true;
+  return false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Produce the next frame on the grid if it is ready. Call this
+    after feeding new samples, as often as frames are wanted.
+    @param  frame Where to store the frame
+    @param  now_us The current micros(), used for the latency bound
+    @returns True if a frame was produced
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_Aligner::getFrame(lis3mdl_frame_t *frame,
+                                        uint32_t now_us) {
+  if (_sensors == 0)
+    return false;
+
+  if (!_started) {
+    // Begin at the newest sample of the sensor that started last
+    for (uint8_t s = 0; s < _sensors; s++)
+      if (_tracks[s].count == 0)
+        return false;
+    _next_us = _tracks[0].time[_tracks[0].head];
+    for (uint8_t s = 1; s < _sensors; s++) {
+      uint32_t t = _tracks[s].time[_tracks[s].head];
+      if ((int32_t)(t - _next_us) > 0)
+        _next_us = t;
+    }
+    _started = true;
+  }
+
+  bool waiting = false;
+  uint32_t valid = 0;
+  for (uint8_t s = 0; s < _sensors; s++) {
+    int16_t xyz[3] = {0, 0, 0};
+    bool late;
+    if (interpolate(&_tracks[s], _next_us, xyz, &late))
+      valid |= (uint32_t)1 << s;
+    else if (!late)
+      waiting = true;
+    frame->x[s] = xyz[0];
+    frame->y[s] = xyz[1];
+    frame->z[s] = xyz[2];
+  }
+
+  if (waiting && (int32_t)(now_us - _next_us) < (int32_t)_maxLatency_us)
+    return false;
+
+  frame->timestamp_us = _next_us;
+  frame->sequence = _sequence++;
+  frame->valid = valid;
+  _next_us += _gridPeriod_us;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read back the clock model of one sensor
+    @param  sensor Index returned by addSensor()
+    @param  phase_us Estimated micros() time of the newest sample
+    @param  period_q8 Estimated sample period in 1/256 us
+    @returns False if the sensor has no samples yet
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_Aligner::getClock(uint8_t sensor, uint32_t *phase_us,
+                                        uint32_t *period_q8) {
+  if (sensor >= _sensors || _tracks[sensor].count == 0)
+    return false;
+  *phase_us = _tracks[sensor].phase_us;
+  *period_q8 = _tracks[sensor].period_q8;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  How far a sensor's data rate is from its nominal value
+    @param  sensor Index returned by addSensor()
+    @returns Rate error in ppm, positive if the sensor runs fast
+*/
+/**************************************************************************/
+int32_t Adafruit_LIS3MDL_Aligner::getRateOffset(uint8_t sensor) {
+  if (sensor >= _sensors)
+    return 0;
+  const lis3mdl_align_track_t *track = &_tracks[sensor];
+  return (int32_t)(((int64_t)track->nominal_q8 - track->period_q8) * 1000000 /
+                   track->period_q8);
+}
@@ -0,0 +1,74 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Aligner.h
+ *
+ * Aligns the free-running sample streams of several LIS3MDL sensors onto a
+ * common time grid
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_ALIGNER_H
+#define ADAFRUIT_LIS3MDL_ALIGNER_H
+
+#include <Adafruit_LIS3MDL.h>
+
+#ifndef LIS3MDL_ALIGN_MAX_SENSORS
+/** Sensors per aligner, at most 32. Define before including to change. */
+#define LIS3MDL_ALIGN_MAX_SENSORS 8
+#endif
+
+#ifndef LIS3MDL_ALIGN_HISTORY
+/** Samples kept per sensor for interpolation, a power of two */
+#define LIS3MDL_ALIGN_HISTORY 4
+#endif
+
+/** One set of readings from every sensor, interpolated to the same time */
+typedef struct {
+  uint32_t timestamp_us;                ///< Grid time, on the micros() clock
+  uint32_t sequence;                    ///< Frame number, from 0
+  uint32_t valid;                       ///< Bit n set if sensor n has data
+  int16_t x[LIS3MDL_ALIGN_MAX_SENSORS]; ///< X axis in raw units
+  int16_t y[LIS3MDL_ALIGN_MAX_SENSORS]; ///< Y axis in raw units
+  int16_t z[LIS3MDL_ALIGN_MAX_SENSORS]; ///< Z axis in raw units
+} lis3mdl_frame_t;
+
+/** Clock model and recent samples of one sensor */
+typedef struct {
+  uint32_t nominal_q8;                     ///< Datasheet period, us/256
+  uint32_t period_q8;                      ///< Estimated period, us/256
+  uint32_t phase_us;                       ///< Time of newest sample
+  uint8_t phaseFrac;                       ///< phase_us fraction, 1/256
+  uint8_t head;                            ///< Index of newest sample
+  uint8_t stored;                          ///< Valid history entries
+  uint32_t count;                          ///< Samples accepted
+  uint32_t time[LIS3MDL_ALIGN_HISTORY];    ///< Filtered sample times
+  int16_t value[LIS3MDL_ALIGN_HISTORY][3]; ///< Raw X/Y/Z
+} lis3mdl_align_track_t;
+
+/** Builds synchronized frames from several independently clocked sensors */
+class Adafruit_LIS3MDL_Aligner {
+public:
+  Adafruit_LIS3MDL_Aligner(void);
+
+  void begin(uint32_t gridPeriod_us, uint32_t maxLatency_us);
+  int8_t addSensor(lis3mdl_dataRate_t dataRate);
+  bool addSample(uint8_t sensor, const lis3mdl_sample_t *sample,
+                 uint32_t timestamp_us);
+  bool getFrame(lis3mdl_frame_t *frame, uint32_t now_us);
+
+  bool getClock(uint8_t sensor, uint32_t *phase_us, uint32_t *period_q8);
+  int32_t getRateOffset(uint8_t sensor);
+
+private:
+  bool interpolate(const lis3mdl_align_track_t *track, uint32_t when_us,
+                   int16_t *xyz, bool *late);
+
+  lis3mdl_align_track_t _tracks[LIS3MDL_ALIGN_MAX_SENSORS];
+  uint8_t _sensors;
+  uint32_t _gridPeriod_us;
+  uint32_t _maxLatency_us;
+  uint32_t _next_us;
+  uint32_t _sequence;
+  bool _started;
+};
+
+#endif
@@ -0,0 +1,395 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Array.cpp
+ *
+ * Per-frame processing for rigid magnetometer arrays. Each sensor's reading
+ * is corrected with one offset subtraction and one 3x3 multiply (its own
+ * calibration folded together with its rotation into the array frame),
+ * after which readings can be differenced or fitted with a field gradient.
+ *
+ * The gradient is the least-squares fit of B(p) = B0 + G (p - c) over the
+ * sensor positions p. With centred positions d, the fit reduces to
+ * G[a][b] = sum_i B_a(i) * w_b(i), where w(i) = S^-1 d(i) and S is the
+ * scatter matrix of the positions. The weights only depend on geometry, so
+ * they are computed once and every frame costs nine dot products.
+ *
+ * Arrays laid out in a plane normal to one axis cannot see the gradient
+ * along that axis; for those the missing column is filled in from the
+ * source-free field conditions, G symmetric and trace zero.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_Array.h"
+
+/**************************************************************************/
+/*!
+    @brief Invert a 3x3 matrix
+    @param in The matrix to invert
+    @param out Where to store the inverse, may not alias in
+    @returns False if the matrix is singular
+*/
+/**************************************************************************/
+bool lis3mdl_mat3_invert(const float in[3][3], float out[3][3]) {
+  float c00 = in[1][1] * in[2][2] - in[1][2] * in[2][1];
+  float c01 = in[1][2] * in[2][0] - in[1][0] * in[2][2];
+  float c02 = in[1][0] * in[2][1] - in[1][1] * in[2][0];
+  float det = in[0][0] * c00 + in[0][1] * c01 + in[0][2] * c02;
+
+  if (det == 0)
+    return false;
+
+  float inv = 1.0f / det;
+  out[0][0] = c00 * inv;
+  out[0][1] = (in[0][2] * in[2][1] - in[0][1] * in[2][2]) * inv;
+  out[0][2] = (in[0][1] * in[1][2] - in[0][2] * in[1][1]) * inv;
+  out[1][0] = c01 * inv;
+  out[1][1] = (in[0][0] * in[2][2] - in[0][2] * in[2][0]) * inv;
+  out[1][2] = (in[0][2] * in[1][0] - in[0][0] * in[1][2]) * inv;
+  out[2][0] = c02 * inv;
+  out[2][1] = (in[0][1] * in[2][0] - in[0][0] * in[2][1]) * inv;
+  out[2][2] = (in[0][0] * in[1][1] - in[0][1] * in[1][0]) * inv;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief Multiply two 3x3 matrices
+    @param a Left operand
+    @param b Right operand
+    @param out Where to store a * b, may not alias a or b
+*/
+/**************************************************************************/
+void lis3mdl_mat3_multiply(const float a[3][3], const float b[3][3],
+                           float out[3][3]) {
+  for (uint8_t r = 0; r < 3; r++)
+    for (uint8_t c = 0; c < 3; c++)
+      out[r][c] = a[r][0] * b[0][c] + a[r][1] * b[1][c] + a[r][2] * b[2][c];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates an empty array
+*/
+/**************************************************************************/
+Adafruit_LIS3MDL_Array::Adafruit_LIS3MDL_Array(void) { begin(0); }
+
+/**************************************************************************/
+/*!
+    @brief  Reset the array: every sensor at the origin with no correction
+    @param  sensors Number of sensors, at most LIS3MDL_ARRAY_MAX_SENSORS
+    @returns False if there are too many sensors
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_Array::begin(uint8_t sensors) {
+  if (sensors > LIS3MDL_ARRAY_MAX_SENSORS)
+    return false;
+
+  _sensors = sensors;
+  _missingAxis = 3;
+  memset(_bx, 0, sizeof(_bx));
+  memset(_by, 0, sizeof(_by));
+  memset(_bz, 0, sizeof(_bz));
+  memset(_offset, 0, sizeof(_offset));
+  memset(_matrix, 0, sizeof(_matrix));
+  memset(_weight, 0, sizeof(_weight));
+  memset(_position, 0, sizeof(_position));
+  for (uint8_t i = 0; i < LIS3MDL_ARRAY_MAX_SENSORS; i++) {
+    _matrix[0][i] = 1;
+    _matrix[4][i] = 1;
+    _matrix[8][i] = 1;
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set where a sensor sits in the array frame. Call setGeometry()
+    once all positions are set.
+    @param  sensor Sensor index
+    @param  x X position, in the length unit the gradient should use
+    @param  y Y position
+    @param  z Z position
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Array::setPosition(uint8_t sensor, float x, float y,
+                                         float z) {
+  if (sensor >= _sensors)
+    return;
+  _position[sensor][0] = x;
+  _position[sensor][1] = y;
+  _position[sensor][2] = z;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read back where a sensor sits in the array frame
+    @param  sensor Sensor index
+    @param  position Where to store X/Y/Z
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Array::getPosition(uint8_t sensor, float position[3]) {
+  if (sensor >= _sensors)
+    return;
+  position[0] = _position[sensor][0];
+  position[1] = _position[sensor][1];
+  position[2] = _position[sensor][2];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Precompute the gradient weights from the sensor positions
+    @returns False if the sensors do not span at least a plane normal to
+    one of the axes, in which case getGradient() returns zeros
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_Array::setGeometry(void) {
+  float centre[3] = {0, 0, 0};
+  float scatter[3][3], inverse[3][3];
+
+  memset(_weight, 0, sizeof(_weight));
+  _missingAxis = 3;
+  if (_sensors < 3)
+    return false;
+
+  for (uint8_t i = 0; i < _sensors; i++)
+    for (uint8_t a = 0; a < 3; a++)
+      centre[a] += _position[i][a] / _sensors;
+
+  memset(scatter, 0, sizeof(scatter));
+  for (uint8_t i = 0; i < _sensors; i++)
+    for (uint8_t a = 0; a < 3; a++)
+      for (uint8_t b = 0; b < 3; b++)
+        scatter[a][b] +=
+            (_position[i][a] - centre[a]) * (_position[i][b] - centre[b]);
+
+  // An axis with no spread is left out of the fit
+  float trace = scatter[0][0] + scatter[1][1] + scatter[2][2];
+  uint8_t missing = 0;
+  for (uint8_t a = 0; a < 3; a++) {
+    if (scatter[a][a] <= trace * 1e-6f) {
+      _missingAxis = a;
+      missing++;
+      for (uint8_t b = 0; b < 3; b++)
+        scatter[a][b] = scatter[b][a] = (a == b);
+    }
+  }
+  if (missing > 1 || !lis3mdl_mat3_invert(scatter, inverse)) {
+    _missingAxis = 3;
+    return false;
+  }
+
+  for (uint8_t i = 0; i < _sensors; i++) {
+    float d[3];
+    for (uint8_t a = 0; a < 3; a++)
+      d[a] = _position[i][a] - centre[a];
+    for (uint8_t a = 0; a < 3; a++)
+      _weight[a][i] = (a == _missingAxis)
+                          ? 0
+                          : inverse[a][0] * d[0] + inverse[a][1] * d[1] +
+                                inverse[a][2] * d[2];
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the correction for one sensor
+    @param  sensor Sensor index
+    @param  cal Offset and correction matrix
+    @param  rotation Optional rotation from the sensor's axes into the array
+    frame, applied after the calibration matrix
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Array::setCalibration(uint8_t sensor,
+                                            const lis3mdl_calibration_t *cal,
+                                            const float rotation[3][3]) {
+  float combined[3][3];
+
+  if (sensor >= _sensors)
+    return;
+
+  if (rotation)
+    lis3mdl_mat3_multiply(rotation, cal->matrix, combined);
+  else
+    memcpy(combined, cal->matrix, sizeof(combined));
+
+  for (uint8_t a = 0; a < 3; a++)
+    _offset[a][sensor] = cal->offset[a];
+  for (uint8_t k = 0; k < 9; k++)
+    _matrix[k][sensor] = combined[k / 3][k % 3];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Load one sensor's uncorrected reading
+    @param  sensor Sensor index
+    @param  sample Raw reading
+    @param  range The range the reading was taken at
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Array::setSample(uint8_t sensor,
+                                       const lis3mdl_sample_t *sample,
+                                       lis3mdl_range_t range) {
+  float scale = 1.0f / lis3mdl_rangeToLSBPerGauss(range);
+  setField(sensor, sample->x * scale, sample->y * scale, sample->z * scale);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Load uncorrected readings from an aligned frame. Sensor n of the
+    frame becomes sensor n of the array.
+    @param  frame Frame from Adafruit_LIS3MDL_Aligner
+    @param  range The range all sensors were read at
+    @returns False if the frame is missing data for any sensor of the array;
+    those sensors are left as they were
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_Array::setFrame(const lis3mdl_frame_t *frame,
+                                      lis3mdl_range_t range) {
+  float scale = 1.0f / lis3mdl_rangeToLSBPerGauss(range);
+  bool complete = true;
+
+  for (uint8_t i = 0; i < _sensors; i++) {
+    if (i >= LIS3MDL_ALIGN_MAX_SENSORS || !(frame->valid & (1UL << i))) {
+      complete = false;
+      continue;
+    }
+    setField(i, frame->x[i] * scale, frame->y[i] * scale, frame->z[i] * scale);
+  }
+  return complete;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Load one sensor's uncorrected reading in gauss
+    @param  sensor Sensor index
+    @param  x X axis in gauss
+    @param  y Y axis in gauss
+    @param  z Z axis in gauss
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Array::setField(uint8_t sensor, float x, float y,
+                                      float z) {
+  if (sensor >= _sensors)
+    return;
+  _bx[sensor] = x;
+  _by[sensor] = y;
+  _bz[sensor] = z;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Apply every sensor's correction to the loaded readings, in place
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Array::calibrate(void) {
+  for (uint8_t i = 0; i < _sensors; i++) {
+    float dx = _bx[i] - _offset[0][i];
+    float dy = _by[i] - _offset[1][i];
+    float dz = _bz[i] - _offset[2][i];
+    float x = _matrix[0][i] * dx + _matrix[1][i] * dy + _matrix[2][i] * dz;
+    float y = _matrix[3][i] * dx + _matrix[4][i] * dy + _matrix[5][i] * dz;
+    float z = _matrix[6][i] * dx + _matrix[7][i] * dy + _matrix[8][i] * dz;
+    _bx[i] = x;
+    _by[i] = y;
+    _bz[i] = z;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Read back one sensor's field
+    @param  sensor Sensor index
+    @param  field Where to store X/Y/Z in gauss
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Array::getField(uint8_t sensor, float field[3]) {
+  if (sensor >= _sensors)
+    return;
+  field[0] = _bx[sensor];
+  field[1] = _by[sensor];
+  field[2] = _bz[sensor];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Difference between two sensors, which cancels any uniform
+    background field such as the Earth's
+    @param  sensor Sensor index
+    @param  reference Index of the sensor to subtract
+    @param  diff Where to store sensor - reference in gauss
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Array::getDifference(uint8_t sensor, uint8_t reference,
+                                           float diff[3]) {
+  if (sensor >= _sensors || reference >= _sensors)
+    return;
+  diff[0] = _bx[sensor] - _bx[reference];
+  diff[1] = _by[sensor] - _by[reference];
+  diff[2] = _bz[sensor] - _bz[reference];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Average field over the array
+    @param  field Where to store X/Y/Z in gauss
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Array::getMean(float field[3]) {
+  float sx = 0, sy = 0, sz = 0;
+
+  for (uint8_t i = 0; i < _sensors; i++) {
+    sx += _bx[i];
+    sy += _by[i];
+    sz += _bz[i];
+  }
+  float inv = _sensors ? 1.0f / _sensors : 0;
+  field[0] = sx * inv;
+  field[1] = sy * inv;
+  field[2] = sz * inv;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Least-squares field gradient across the array
+    @param  gradient Where to store dB_a/dx_b as gradient[a][b], in gauss
+    per position unit
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Array::getGradient(float gradient[3][3]) {
+  float gxx = 0, gxy = 0, gxz = 0;
+  float gyx = 0, gyy = 0, gyz = 0;
+  float gzx = 0, gzy = 0, gzz = 0;
+
+  for (uint8_t i = 0; i < _sensors; i++) {
+    float wx = _weight[0][i], wy = _weight[1][i], wz = _weight[2][i];
+    gxx += _bx[i] * wx;
+    gxy += _bx[i] * wy;
+    gxz += _bx[i] * wz;
+    gyx += _by[i] * wx;
+    gyy += _by[i] * wy;
+    gyz += _by[i] * wz;
+    gzx += _bz[i] * wx;
+    gzy += _bz[i] * wy;
+    gzz += _bz[i] * wz;
+  }
+
+  gradient[0][0] = gxx;
+  gradient[0][1] = gxy;
+  gradient[0][2] = gxz;
+  gradient[1][0] = gyx;
+  gradient[1][1] = gyy;
+  gradient[1][2] = gyz;
+  gradient[2][0] = gzx;
+  gradient[2][1] = gzy;
+  gradient[2][2] = gzz;
+
+  uint8_t k = _missingAxis;
+  if (k < 3) {
+    uint8_t a = (k + 1) % 3, b = (k + 2) % 3;
+    gradient[a][k] = gradient[k][a];
+    gradient[b][k] = gradient[k][b];
+    gradient[k][k] = -(gradient[a][a] + gradient[b][b]);
+  }
+}
@@ -0,0 +1,84 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Array.h
+ *
+ * Calibration, differencing and gradient estimation for rigid arrays of
+ * LIS3MDL sensors
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_ARRAY_H
+#define ADAFRUIT_LIS3MDL_ARRAY_H
+
+#include <Adafruit_LIS3MDL.h>
+#include <Adafruit_LIS3MDL_Aligner.h>
+
+#ifndef LIS3MDL_ARRAY_MAX_SENSORS
+#if defined(__AVR__)
+#define LIS3MDL_ARRAY_MAX_SENSORS 4 ///< Sensors per array on small parts
+#else
+#define LIS3MDL_ARRAY_MAX_SENSORS 32 ///< Sensors per array
+#endif
+#endif
+
+/*!
+ * Correction for one sensor: corrected = matrix * (gauss - offset). The
+ * matrix holds soft-iron and scale correction and, for arrays, the
+ * rotation of the sensor into the array frame.
+ */
+typedef struct {
+  float offset[3];    ///< Hard-iron offset in gauss
+  float matrix[3][3]; ///< Row-major correction matrix
+} lis3mdl_calibration_t;
+
+bool lis3mdl_mat3_invert(const float in[3][3], float out[3][3]);
+void lis3mdl_mat3_multiply(const float a[3][3], const float b[3][3],
+                           float out[3][3]);
+
+/*!
+ * N-sensor frame in structure-of-arrays layout. Each kernel walks one
+ * contiguous array per quantity, so compilers can vectorize across sensors.
+ */
+class Adafruit_LIS3MDL_Array {
+public:
+  Adafruit_LIS3MDL_Array(void);
+
+  bool begin(uint8_t sensors);
+  void setPosition(uint8_t sensor, float x, float y, float z);
+  void getPosition(uint8_t sensor, float position[3]);
+  bool setGeometry(void);
+  void setCalibration(uint8_t sensor, const lis3mdl_calibration_t *cal,
+                      const float rotation[3][3] = NULL);
+
+  void setSample(uint8_t sensor, const lis3mdl_sample_t *sample,
+                 lis3mdl_range_t range);
+  bool setFrame(const lis3mdl_frame_t *frame, lis3mdl_range_t range);
+  void setField(uint8_t sensor, float x, float y, float z);
+
+  void calibrate(void);
+  void getField(uint8_t sensor, float field[3]);
+  void getDifference(uint8_t sensor, uint8_t reference, float diff[3]);
+  void getMean(float field[3]);
+  void getGradient(float gradient[3][3]);
+
+  /*!
+   *    @brief  Number of sensors set by begin()
+   *    @return Sensor count
+   */
+  uint8_t sensors(void) { return _sensors; }
+
+private:
+  uint8_t _sensors;
+  uint8_t _missingAxis; // 0-2 for a planar array, 3 otherwise
+
+  // Hot data, one array per quantity
+  float _bx[LIS3MDL_ARRAY_MAX_SENSORS];
+  float _by[LIS3MDL_ARRAY_MAX_SENSORS];
+  float _bz[LIS3MDL_ARRAY_MAX_SENSORS];
+  float _offset[3][LIS3MDL_ARRAY_MAX_SENSORS];
+  float _matrix[9][LIS3MDL_ARRAY_MAX_SENSORS];
+  float _weight[3][LIS3MDL_ARRAY_MAX_SENSORS];
+
+  float _position[LIS3MDL_ARRAY_MAX_SENSORS][3];
+};
+
+#endif
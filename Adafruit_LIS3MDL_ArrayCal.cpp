@@ -0,0 +1,197 @@
+/*!
+ * @file     Adafruit_LIS3MDL_ArrayCal.cpp
+ *
+ * When a rigid array is turned in a steady field, every sensor sees the
+ * same field in the array frame, so each sensor's readings m relate to the
+ * reference's readings r by r = M (m - o). M absorbs the sensor's mounting
+ * rotation, scale and cross-axis error relative to the reference, and o is
+ * its offset. The least-squares M is cross * cov^-1, where cov is the
+ * co-moment of the sensor's readings and cross that of the reference
+ * against them. Both are updated one reading at a time with Welford's
+ * method, which stays accurate in single precision and keeps 22 floats per
+ * sensor no matter how long the capture runs.
+ *
+ * If the reference's readings are themselves uncorrected, every sensor is
+ * mapped into the reference's raw frame; its offset is then common to all
+ * sensors and cancels in differences and gradients.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_ArrayCal.h"
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a calibration with no sensors
+*/
+/**************************************************************************/
+Adafruit_LIS3MDL_ArrayCal::Adafruit_LIS3MDL_ArrayCal(void) { begin(0); }
+
+/**************************************************************************/
+/*!
+    @brief  Start a new capture
+    @param  sensors Number of sensors in the array
+    @param  reference Index of the sensor the others are aligned to
+    @returns False if there are too many sensors or the reference is not
+    one of them
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_ArrayCal::begin(uint8_t sensors, uint8_t reference) {
+  memset(_stats, 0, sizeof(_stats));
+  _sensors = 0;
+  _reference = 0;
+  if (sensors > LIS3MDL_ARRAY_MAX_SENSORS ||
+      (sensors != 0 && reference >= sensors))
+    return false;
+  _sensors = sensors;
+  _reference = reference;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Accumulate one pair of simultaneous readings
+    @param  sensor Sensor index
+    @param  field The sensor's uncorrected reading in gauss
+    @param  reference The reference sensor's reading at the same time
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_ArrayCal::addReading(uint8_t sensor,
+                                           const float field[3],
+                                           const float reference[3]) {
+  if (sensor >= _sensors)
+    return;
+
+  lis3mdl_alignment_stats_t *s = &_stats[sensor];
+  float dm[3], dr[3];
+
+  s->count++;
+  for (uint8_t a = 0; a < 3; a++) {
+    dm[a] = field[a] - s->mean[a];
+    s->mean[a] += dm[a] / s->count;
+    dr[a] = reference[a] - s->meanRef[a];
+    s->meanRef[a] += dr[a] / s->count;
+  }
+  for (uint8_t a = 0; a < 3; a++) {
+    for (uint8_t b = 0; b < 3; b++) {
+      float after = field[b] - s->mean[b];
+      s->cov[a][b] += dm[a] * after;
+      s->cross[a][b] += dr[a] * after;
+    }
+    s->refVar += dr[a] * (reference[a] - s->meanRef[a]);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Accumulate every sensor of an array against the reference.
+    Call after loading a frame and before Adafruit_LIS3MDL_Array::calibrate().
+    @param  array Array holding one set of uncorrected readings
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_ArrayCal::addFrame(Adafruit_LIS3MDL_Array *array) {
+  float reference[3], field[3];
+
+  array->getField(_reference, reference);
+  for (uint8_t i = 0; i < _sensors; i++) {
+    array->getField(i, field);
+    addReading(i, field, reference);
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Compute one sensor's alignment from the readings so far
+    @param  sensor Sensor index
+    @param  cal Where to store the offset and matrix mapping the sensor onto
+    the reference
+    @returns False if the array has not been turned through enough
+    orientations to tell the axes apart
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_ArrayCal::solve(uint8_t sensor,
+                                      lis3mdl_calibration_t *cal) {
+  if (sensor >= _sensors)
+    return false;
+
+  if (sensor == _reference) {
+    memset(cal, 0, sizeof(*cal));
+    cal->matrix[0][0] = cal->matrix[1][1] = cal->matrix[2][2] = 1;
+    return true;
+  }
+
+  const lis3mdl_alignment_stats_t *s = &_stats[sensor];
+  float inverse[3][3], matrixInverse[3][3];
+
+  // Every axis needs a fair share of the variation, not just some
+  float trace = s->cov[0][0] + s->cov[1][1] + s->cov[2][2];
+  float det = s->cov[0][0] * (s->cov[1][1] * s->cov[2][2] -
+                              s->cov[1][2] * s->cov[2][1]) -
+              s->cov[0][1] * (s->cov[1][0] * s->cov[2][2] -
+                              s->cov[1][2] * s->cov[2][0]) +
+              s->cov[0][2] * (s->cov[1][0] * s->cov[2][1] -
+                              s->cov[1][1] * s->cov[2][0]);
+  if (s->count < 4 || trace <= 0 ||
+      det < 1e-3f * trace * trace * trace / 27 ||
+      !lis3mdl_mat3_invert(s->cov, inverse))
+    return false;
+
+  lis3mdl_mat3_multiply(s->cross, inverse, cal->matrix);
+  if (!lis3mdl_mat3_invert(cal->matrix, matrixInverse))
+    return false;
+
+  // r = M (m - o) at the means gives o = mean - M^-1 meanRef
+  for (uint8_t a = 0; a < 3; a++)
+    cal->offset[a] = s->mean[a] - (matrixInverse[a][0] * s->meanRef[0] +
+                                   matrixInverse[a][1] * s->meanRef[1] +
+                                   matrixInverse[a][2] * s->meanRef[2]);
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Solve every sensor and load the results into an array
+    @param  array The array to update with setCalibration()
+    @returns False if any sensor could not be solved; those keep their
+    previous calibration
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_ArrayCal::solve(Adafruit_LIS3MDL_Array *array) {
+  lis3mdl_calibration_t cal;
+  bool ok = true;
+
+  for (uint8_t i = 0; i < _sensors; i++) {
+    if (solve(i, &cal))
+      array->setCalibration(i, &cal);
+    else
+      ok = false;
+  }
+  return ok;
+}
+
+/**************************************************************************/
+/*!
+    @brief  How well the fitted alignment explains the readings
+    @param  sensor Sensor index
+    @returns RMS difference from the reference per axis, in gauss, or -1 if
+    the sensor cannot be solved yet
+*/
+/**************************************************************************/
+float Adafruit_LIS3MDL_ArrayCal::getResidual(uint8_t sensor) {
+  lis3mdl_calibration_t cal;
+
+  if (!solve(sensor, &cal))
+    return -1;
+  if (sensor == _reference)
+    return 0;
+
+  // Residual sum of squares is tr(Crr) - tr(M cross^T)
+  const lis3mdl_alignment_stats_t *s = &_stats[sensor];
+  float explained = 0;
+  for (uint8_t a = 0; a < 3; a++)
+    for (uint8_t b = 0; b < 3; b++)
+      explained += cal.matrix[a][b] * s->cross[a][b];
+  float sse = s->refVar - explained;
+  return sse > 0 ? sqrt(sse / (3.0f * s->count)) : 0;
+}
@@ -0,0 +1,55 @@
+/*!
+ * @file     Adafruit_LIS3MDL_ArrayCal.h
+ *
+ * Inter-sensor alignment calibration for rigid LIS3MDL arrays
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_ARRAYCAL_H
+#define ADAFRUIT_LIS3MDL_ARRAYCAL_H
+
+#include <Adafruit_LIS3MDL_Array.h>
+
+/** Running means and co-moments of one sensor against the reference */
+typedef struct {
+  uint32_t count;    ///< Readings accumulated
+  float mean[3];     ///< Mean of the sensor's readings
+  float meanRef[3];  ///< Mean of the reference readings
+  float cov[3][3];   ///< Co-moment of the sensor with itself
+  float cross[3][3]; ///< Co-moment of the reference with the sensor
+  float refVar;      ///< Trace of the reference's own co-moment
+} lis3mdl_alignment_stats_t;
+
+/*!
+ * Estimates how each sensor of an array maps onto a reference sensor, from
+ * readings taken while the whole array is turned through many orientations
+ * in a steady field. Only running statistics are kept, never the readings.
+ */
+class Adafruit_LIS3MDL_ArrayCal {
+public:
+  Adafruit_LIS3MDL_ArrayCal(void);
+
+  bool begin(uint8_t sensors, uint8_t reference = 0);
+  void addReading(uint8_t sensor, const float field[3],
+                  const float reference[3]);
+  void addFrame(Adafruit_LIS3MDL_Array *array);
+  bool solve(uint8_t sensor, lis3mdl_calibration_t *cal);
+  bool solve(Adafruit_LIS3MDL_Array *array);
+  float getResidual(uint8_t sensor);
+
+  /*!
+   *    @brief  Readings accumulated for one sensor
+   *    @param  sensor Sensor index
+   *    @return Reading count
+   */
+  uint32_t count(uint8_t sensor) {
+    return sensor < _sensors ? _stats[sensor].count : 0;
+  }
+
+private:
+  lis3mdl_alignment_stats_t _stats[LIS3MDL_ARRAY_MAX_SENSORS];
+  uint8_t _sensors;
+  uint8_t _reference;
+};
+
+#endif
@@ -0,0 +1,99 @@
+/*!
+ * @file     Adafruit_LIS3MDL_BusPlan.cpp
+ *
+ * Bus time taken by LIS3MDL sample reads, and the data rate a shared bus
+ * can sustain.
+ *
+ * Every sample is one burst read with an address phase. On I2C that is a
+ * start, the address and register bytes, a repeated start, the address
+ * again, the data and a stop, each byte taking 9 clocks with its
+ * acknowledge; on SPI one address byte and the data at 8 clocks each. The
+ * per-transaction overhead covers what the host spends outside the wire,
+ * such as driver calls and bus arbitration, and is best measured.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_BusPlan.h"
+
+/**************************************************************************/
+/*!
+    @brief Data bytes fetched per sample by a read mode
+    @param readMode The read mode
+    @returns Byte count, not including the address phase
+*/
+/**************************************************************************/
+uint8_t lis3mdl_readBytes(lis3mdl_readmode_t readMode) {
+  switch (readMode) {
+  case LIS3MDL_READ_AXIS:
+    return 2;
+  case LIS3MDL_READ_FAST:
+    return 3;
+  case LIS3MDL_READ_STATUS_XYZ:
+    return 7;
+  case LIS3MDL_READ_STATUS_XYZ_TEMP:
+    return 9;
+  case LIS3MDL_READ_XYZ:
+  default:
+    return 6;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief Bus time for one sample read
+    @param bus The bus
+    @param readMode The read mode
+    @returns Time in ns, wire time plus the bus's overhead
+*/
+/**************************************************************************/
+uint32_t lis3mdl_readTime_ns(const lis3mdl_bus_config_t *bus,
+                             lis3mdl_readmode_t readMode) {
+  uint32_t bytes = lis3mdl_readBytes(readMode);
+  uint32_t clocks;
+
+  if (!bus->clock_Hz)
+    return 0xFFFFFFFF;
+  if (bus->type == LIS3MDL_BUS_I2C)
+    clocks = 3 + 9 * (3 + bytes); // start, restart and stop are ~1 each
+  else
+    clocks = 8 * (1 + bytes);
+  return (uint32_t)((uint64_t)clocks * 1000000000 / bus->clock_Hz) +
+         bus->overhead_ns;
+}
+
+/**************************************************************************/
+/*!
+    @brief Check a set of sensors sharing one bus
+    @param bus The bus
+    @param sensors Read mode and rate of each sensor
+    @param count Number of sensors
+    @param report Where to store utilization and the highest rate all
+    sensors could share within LIS3MDL_BUS_MAX_UTILIZATION
+    @returns True if the requested rates are sustainable
+*/
+/**************************************************************************/
+bool lis3mdl_planBus(const lis3mdl_bus_config_t *bus,
+                     const lis3mdl_bus_load_t *sensors, uint8_t count,
+                     lis3mdl_bus_report_t *report) {
+  uint64_t busy = 0;     // ns of bus time per 1000 s
+  uint64_t perRound = 0; // ns to read every sensor once
+
+  for (uint8_t i = 0; i < count; i++) {
+    uint32_t t = lis3mdl_readTime_ns(bus, sensors[i].readMode);
+    busy += (uint64_t)t * sensors[i].rate_mHz;
+    perRound += t;
+  }
+
+  uint64_t utilization = busy / 1000000000;
+  report->utilization =
+      utilization > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)utilization;
+  report->maxRate_mHz =
+      perRound ? (uint32_t)((uint64_t)LIS3MDL_BUS_MAX_UTILIZATION *
+                            1000000000 / perRound)
+               : 0xFFFFFFFF;
+  report->maxDataRate = lis3mdl_fastestDataRate(report->maxRate_mHz);
+  report->sustainable = report->utilization <= LIS3MDL_BUS_MAX_UTILIZATION;
+  return report->sustainable;
+}
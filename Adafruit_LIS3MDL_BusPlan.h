@@ -0,0 +1,63 @@
+/*!
+ * @file     Adafruit_LIS3MDL_BusPlan.h
+ *
+ * Bus throughput model for checking LIS3MDL data rates against the
+ * transport before configuring them
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_BUSPLAN_H
+#define ADAFRUIT_LIS3MDL_BUSPLAN_H
+
+#include <Adafruit_LIS3MDL.h>
+
+#ifndef LIS3MDL_BUS_MAX_UTILIZATION
+/** Bus share, in parts per thousand, the planner lets sensor reads take.
+ * The rest absorbs polling jitter and other traffic. */
+#define LIS3MDL_BUS_MAX_UTILIZATION 800
+#endif
+
+/** Transport type */
+typedef enum {
+  LIS3MDL_BUS_I2C, ///< I2C, 9 clocks per byte plus start/restart/stop
+  LIS3MDL_BUS_SPI, ///< 4-wire SPI, 8 clocks per byte
+} lis3mdl_bus_t;
+
+/** What is fetched for each sample, in one burst */
+typedef enum {
+  LIS3MDL_READ_XYZ,             ///< OUT_X_L..OUT_Z_H, 6 bytes (read())
+  LIS3MDL_READ_FAST,            ///< FAST_READ high bytes only, 3 bytes
+  LIS3MDL_READ_STATUS_XYZ,      ///< STATUS + XYZ, 7 bytes (readSample())
+  LIS3MDL_READ_STATUS_XYZ_TEMP, ///< STATUS through TEMP_OUT_H, 9 bytes
+  LIS3MDL_READ_AXIS,            ///< One axis, 2 bytes (readAxes())
+} lis3mdl_readmode_t;
+
+/** A bus and its fixed costs */
+typedef struct {
+  lis3mdl_bus_t type;   ///< I2C or SPI
+  uint32_t clock_Hz;    ///< Bus clock
+  uint32_t overhead_ns; ///< Host time per transaction off the wire
+} lis3mdl_bus_config_t;
+
+/** One sensor's traffic */
+typedef struct {
+  lis3mdl_readmode_t readMode; ///< Burst read per sample
+  uint32_t rate_mHz;           ///< Samples read per second, in mHz
+} lis3mdl_bus_load_t;
+
+/** Planner output */
+typedef struct {
+  uint32_t utilization;           ///< Bus share used, parts per thousand
+  uint32_t maxRate_mHz;           ///< Highest common rate that fits
+  lis3mdl_dataRate_t maxDataRate; ///< Fastest setting at or below that
+  bool sustainable;               ///< Utilization within the limit
+} lis3mdl_bus_report_t;
+
+uint8_t lis3mdl_readBytes(lis3mdl_readmode_t readMode);
+uint32_t lis3mdl_readTime_ns(const lis3mdl_bus_config_t *bus,
+                             lis3mdl_readmode_t readMode);
+bool lis3mdl_planBus(const lis3mdl_bus_config_t *bus,
+                     const lis3mdl_bus_load_t *sensors, uint8_t count,
+                     lis3mdl_bus_report_t *report);
+
+#endif
@@ -0,0 +1,96 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Deadband.cpp
+ *
+ * Each sample is compared with the last one passed on rather than the one
+ * before it, so a slow drift is still reported once it adds up to more
+ * than the deadband.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_Deadband.h"
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a filter that passes every sample on
+*/
+/**************************************************************************/
+Adafruit_LIS3MDL_Deadband::Adafruit_LIS3MDL_Deadband(void) { begin(0); }
+
+/**************************************************************************/
+/*!
+    @brief  Set the same deadband on every axis and start over
+    @param  deadband Largest change, in raw counts, that is not reported
+    @param  heartbeat_ms Pass a sample on at least this often even if
+    nothing changed, 0 for never
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Deadband::begin(uint16_t deadband,
+                                      uint32_t heartbeat_ms) {
+  setDeadband(deadband, deadband, deadband);
+  _heartbeat_ms = heartbeat_ms;
+  reset();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set a separate deadband per axis, for example wider on Z to
+    match its higher noise
+    @param  x X deadband in raw counts
+    @param  y Y deadband in raw counts
+    @param  z Z deadband in raw counts
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Deadband::setDeadband(uint16_t x, uint16_t y,
+                                            uint16_t z) {
+  _deadband[0] = x;
+  _deadband[1] = y;
+  _deadband[2] = z;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Forget the last sample passed on and clear the counters; the
+    next sample is always passed on
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Deadband::reset(void) {
+  _primed = false;
+  _suppressed = 0;
+  _lastGap = 0;
+  _totalSuppressed = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Decide whether a sample should be passed on
+    @param  sample The new sample; its timestamp drives the heartbeat
+    @returns True to pass it on, false if it was suppressed
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_Deadband::update(const lis3mdl_sample_t *sample) {
+  const int16_t value[3] = {sample->x, sample->y, sample->z};
+  bool emit = !_primed;
+
+  for (uint8_t a = 0; a < 3 && !emit; a++) {
+    int32_t change = (int32_t)value[a] - _last[a];
+    if (change > _deadband[a] || -change > _deadband[a])
+      emit = true;
+  }
+  if (!emit && _heartbeat_ms &&
+      sample->timestamp - _lastEmit_ms >= _heartbeat_ms)
+    emit = true;
+
+  if (!emit) {
+    _suppressed++;
+    _totalSuppressed++;
+    return false;
+  }
+  memcpy(_last, value, sizeof(_last));
+  _lastEmit_ms = sample->timestamp;
+  _primed = true;
+  _lastGap = _suppressed;
+  _suppressed = 0;
+  return true;
+}
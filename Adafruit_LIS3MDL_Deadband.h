@@ -0,0 +1,57 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Deadband.h
+ *
+ * Change-only reporting for LIS3MDL samples
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_DEADBAND_H
+#define ADAFRUIT_LIS3MDL_DEADBAND_H
+
+#include <Adafruit_LIS3MDL.h>
+
+/*!
+ * Passes a raw sample on only when an axis has moved more than its
+ * deadband from the last sample passed on, or when the heartbeat interval
+ * has run out. Works on the int16 counts, before any conversion to gauss.
+ */
+class Adafruit_LIS3MDL_Deadband {
+public:
+  Adafruit_LIS3MDL_Deadband(void);
+
+  void begin(uint16_t deadband, uint32_t heartbeat_ms = 0);
+  void setDeadband(uint16_t x, uint16_t y, uint16_t z);
+  void reset(void);
+  bool update(const lis3mdl_sample_t *sample);
+
+  /*!
+   *    @brief  Samples held back between the last two passed on, so after
+   *    update() returns true this is how many readings the sample stands for
+   *    @return Count, updated each time update() returns true
+   */
+  uint32_t getSuppressed(void) { return _lastGap; }
+
+  /*!
+   *    @brief  Samples held back since the last one passed on
+   *    @return Count, reset each time update() returns true
+   */
+  uint32_t getPending(void) { return _suppressed; }
+
+  /*!
+   *    @brief  Samples held back since begin() or reset()
+   *    @return Count
+   */
+  uint32_t getTotalSuppressed(void) { return _totalSuppressed; }
+
+private:
+  int16_t _last[3];
+  uint16_t _deadband[3];
+  uint32_t _heartbeat_ms;
+  uint32_t _lastEmit_ms;
+  uint32_t _suppressed;
+  uint32_t _lastGap;
+  uint32_t _totalSuppressed;
+  bool _primed;
+};
+
+#endif
@@ -0,0 +1,298 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Dipole.cpp
+ *
+ * Point dipole model and a bounded Levenberg-Marquardt tracker for it.
+ *
+ * The field of a dipole with moment m at offset r = p - s from the sensor
+ * is B = k (3 (m.r) r / |r|^5 - m / |r|^3), with k = mu0 / 4 pi, which is
+ * 1e-3 gauss m / A when positions are in metres. A uniform background is
+ * fitted alongside unless the frames are already background-free.
+ *
+ * Each iteration accumulates J^T J and J^T e over the sensors directly, so
+ * memory does not grow with the array, then solves the damped 9x9 system
+ * by Cholesky factorization. A rejected step only raises the damping and
+ * retries with the same normal equations.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_Dipole.h"
+
+#define LIS3MDL_DIPOLE_K 1e-3f          ///< mu0 / 4 pi in gauss m / A
+#define LIS3MDL_DIPOLE_MIN_R2 1e-6f     ///< Closest approach squared, 1 mm
+#define LIS3MDL_DIPOLE_LAMBDA 1e-3f     ///< Starting damping
+#define LIS3MDL_DIPOLE_MIN_LAMBDA 1e-7f ///< Damping floor
+#define LIS3MDL_DIPOLE_MAX_LAMBDA 1e7f  ///< Damping ceiling
+
+/**************************************************************************/
+/*!
+    @brief Field of a dipole in a uniform background at one point
+    @param dipole The source
+    @param point Where to evaluate the field
+    @param field Where to store X/Y/Z in gauss
+*/
+/**************************************************************************/
+void lis3mdl_dipoleField(const lis3mdl_dipole_t *dipole, const float point[3],
+                         float field[3]) {
+  float r[3], r2 = 0, mr = 0;
+
+  for (uint8_t a = 0; a < 3; a++) {
+    r[a] = point[a] - dipole->position[a];
+    r2 += r[a] * r[a];
+    mr += dipole->moment[a] * r[a];
+  }
+  if (r2 < LIS3MDL_DIPOLE_MIN_R2)
+    r2 = LIS3MDL_DIPOLE_MIN_R2;
+
+  float inv3 = LIS3MDL_DIPOLE_K / (r2 * sqrt(r2));
+  float inv5 = 3 * inv3 / r2;
+  for (uint8_t a = 0; a < 3; a++)
+    field[a] = inv5 * mr * r[a] - inv3 * dipole->moment[a] +
+               dipole->background[a];
+}
+
+// Solve (A) x = b in place for symmetric positive definite A
+static bool lis3mdl_choleskySolve(float a[][LIS3MDL_DIPOLE_PARAMS], float *b,
+                                  uint8_t n) {
+  for (uint8_t j = 0; j < n; j++) {
+    float d = a[j][j];
+    for (uint8_t k = 0; k < j; k++)
+      d -= a[j][k] * a[j][k];
+    if (!(d > 0))
+      return false;
+    a[j][j] = sqrt(d);
+    for (uint8_t i = j + 1; i < n; i++) {
+      float s = a[i][j];
+      for (uint8_t k = 0; k < j; k++)
+        s -= a[i][k] * a[j][k];
+      a[i][j] = s / a[j][j];
+    }
+  }
+  for (uint8_t i = 0; i < n; i++) {
+    for (uint8_t k = 0; k < i; k++)
+      b[i] -= a[i][k] * b[k];
+    b[i] /= a[i][i];
+  }
+  for (int8_t i = n - 1; i >= 0; i--) {
+    for (uint8_t k = i + 1; k < n; k++)
+      b[i] -= a[k][i] * b[k];
+    b[i] /= a[i][i];
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a tracker with a dipole 5 cm above the origin
+*/
+/**************************************************************************/
+Adafruit_LIS3MDL_Dipole::Adafruit_LIS3MDL_Dipole(void) {
+  lis3mdl_dipole_t initial;
+  memset(&initial, 0, sizeof(initial));
+  initial.position[2] = 0.05f;
+  initial.moment[2] = 0.1f;
+  begin(&initial);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the starting guess and the per-frame budget
+    @param  initial Where to start, and where to restart after losing track
+    @param  fitBackground Fit a uniform background as well; if false the
+    background given in initial is held fixed, for example at zero when the
+    frames already have it removed
+    @param  maxIterations Iteration cap per frame, each iteration costing two
+    passes over the sensors and one 9x9 solve
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Dipole::begin(const lis3mdl_dipole_t *initial,
+                                    bool fitBackground,
+                                    uint8_t maxIterations) {
+  memcpy(_initial, initial->position, 3 * sizeof(float));
+  memcpy(_initial + 3, initial->moment, 3 * sizeof(float));
+  memcpy(_initial + 6, initial->background, 3 * sizeof(float));
+  _fitted = fitBackground ? 9 : 6;
+  _maxIterations = maxIterations ? maxIterations : 1;
+  reset();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Go back to the starting guess given to begin()
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Dipole::reset(void) {
+  memcpy(_params, _initial, sizeof(_params));
+  _lambda = LIS3MDL_DIPOLE_LAMBDA;
+  _cost = 0;
+  _iterations = 0;
+  _residuals = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Sum of squared residuals of a parameter set against a frame
+    @param  array Calibrated frame
+    @param  params Position, moment and background
+    @returns Sum of squares in gauss^2
+*/
+/**************************************************************************/
+float Adafruit_LIS3MDL_Dipole::cost(Adafruit_LIS3MDL_Array *array,
+                                    const float *params) {
+  lis3mdl_dipole_t dipole;
+  float point[3], measured[3], model[3], sum = 0;
+
+  memcpy(&dipole, params, sizeof(dipole));
+  for (uint8_t i = 0; i < array->sensors(); i++) {
+    array->getPosition(i, point);
+    array->getField(i, measured);
+    lis3mdl_dipoleField(&dipole, point, model);
+    for (uint8_t a = 0; a < 3; a++)
+      sum += (measured[a] - model[a]) * (measured[a] - model[a]);
+  }
+  return sum;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Accumulate J^T J and J^T e at the current parameters
+    @param  array Calibrated frame
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Dipole::normalEquations(Adafruit_LIS3MDL_Array *array) {
+  const float *s = _params, *m = _params + 3, *bg = _params + 6;
+  float jac[3][LIS3MDL_DIPOLE_PARAMS];
+
+  memset(_jtj, 0, sizeof(_jtj));
+  memset(_jtr, 0, sizeof(_jtr));
+  memset(jac, 0, sizeof(jac));
+
+  for (uint8_t i = 0; i < array->sensors(); i++) {
+    float point[3], measured[3], r[3], r2 = 0, mr = 0;
+    array->getPosition(i, point);
+    array->getField(i, measured);
+    for (uint8_t a = 0; a < 3; a++) {
+      r[a] = point[a] - s[a];
+      r2 += r[a] * r[a];
+      mr += m[a] * r[a];
+    }
+    if (r2 < LIS3MDL_DIPOLE_MIN_R2)
+      r2 = LIS3MDL_DIPOLE_MIN_R2;
+    float inv3 = LIS3MDL_DIPOLE_K / (r2 * sqrt(r2));
+    float inv5 = 3 * inv3 / r2;
+    float inv7 = 5 * inv5 / r2;
+
+    float error[3];
+    for (uint8_t a = 0; a < 3; a++) {
+      error[a] = measured[a] - (inv5 * mr * r[a] - inv3 * m[a] + bg[a]);
+      for (uint8_t b = 0; b < 3; b++) {
+        float delta = (a == b);
+        // d/dr, negated because r = point - position
+        jac[a][b] = -(inv5 * (m[b] * r[a] + m[a] * r[b] + mr * delta) -
+                      inv7 * mr * r[a] * r[b]);
+        jac[a][3 + b] = inv5 * r[a] * r[b] - inv3 * delta;
+        jac[a][6 + b] = delta;
+      }
+    }
+
+    for (uint8_t p = 0; p < _fitted; p++) {
+      for (uint8_t q = p; q < _fitted; q++)
+        _jtj[p][q] += jac[0][p] * jac[0][q] + jac[1][p] * jac[1][q] +
+                      jac[2][p] * jac[2][q];
+      _jtr[p] += jac[0][p] * error[0] + jac[1][p] * error[1] +
+                 jac[2][p] * error[2];
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Damp harder after a failed step
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Dipole::raiseDamping(void) {
+  _lambda *= 10;
+  if (_lambda > LIS3MDL_DIPOLE_MAX_LAMBDA)
+    _lambda = LIS3MDL_DIPOLE_MAX_LAMBDA;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Refine the fit against a new frame, starting from the last one
+    @param  array Array holding a calibrated frame, with sensor positions set
+    @returns False if the array has too few sensors for the model
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_Dipole::update(Adafruit_LIS3MDL_Array *array) {
+  float a[LIS3MDL_DIPOLE_PARAMS][LIS3MDL_DIPOLE_PARAMS];
+  float step[LIS3MDL_DIPOLE_PARAMS], trial[LIS3MDL_DIPOLE_PARAMS];
+
+  _iterations = 0;
+  _residuals = array->sensors() * 3;
+  if (_residuals < _fitted)
+    return false;
+
+  _cost = cost(array, _params);
+  if (!(_cost < 1e30f)) { // lost track, NaN or overflow
+    reset();
+    _residuals = array->sensors() * 3;
+    _cost = cost(array, _params);
+  }
+  normalEquations(array);
+
+  while (_iterations < _maxIterations) {
+    _iterations++;
+
+    for (uint8_t p = 0; p < _fitted; p++) {
+      for (uint8_t q = 0; q < _fitted; q++)
+        a[p][q] = p <= q ? _jtj[p][q] : _jtj[q][p];
+      a[p][p] += _lambda * _jtj[p][p] + 1e-12f;
+      step[p] = _jtr[p];
+    }
+    if (!lis3mdl_choleskySolve(a, step, _fitted)) {
+      raiseDamping();
+      continue;
+    }
+
+    memcpy(trial, _params, sizeof(trial));
+    for (uint8_t p = 0; p < _fitted; p++)
+      trial[p] += step[p];
+    float trialCost = cost(array, trial);
+
+    if (trialCost < _cost) {
+      bool converged = _cost - trialCost <= 1e-6f * _cost;
+      memcpy(_params, trial, sizeof(_params));
+      _cost = trialCost;
+      _lambda /= 10;
+      if (_lambda < LIS3MDL_DIPOLE_MIN_LAMBDA)
+        _lambda = LIS3MDL_DIPOLE_MIN_LAMBDA;
+      if (converged || _iterations == _maxIterations)
+        break;
+      normalEquations(array);
+    } else {
+      raiseDamping();
+    }
+  }
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  The current estimate
+    @param  state Where to store position, moment and background
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Dipole::getState(lis3mdl_dipole_t *state) {
+  memcpy(state, _params, sizeof(*state));
+}
+
+/**************************************************************************/
+/*!
+    @brief  How well the estimate fits the last frame
+    @returns RMS residual per axis in gauss
+*/
+/**************************************************************************/
+float Adafruit_LIS3MDL_Dipole::getResidual(void) {
+  return _residuals ? sqrt(_cost / _residuals) : 0;
+}
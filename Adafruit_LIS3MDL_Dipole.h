@@ -0,0 +1,68 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Dipole.h
+ *
+ * Magnetic dipole localization over LIS3MDL sensor arrays
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_DIPOLE_H
+#define ADAFRUIT_LIS3MDL_DIPOLE_H
+
+#include <Adafruit_LIS3MDL_Array.h>
+
+/** Parameters fitted by the dipole tracker */
+#define LIS3MDL_DIPOLE_PARAMS 9
+
+/** A point dipole in a uniform background field, in the array frame */
+typedef struct {
+  float position[3];   ///< Dipole position, in the array's length unit
+  float moment[3];     ///< Dipole moment in A m^2 (positions in metres)
+  float background[3]; ///< Uniform background field in gauss
+} lis3mdl_dipole_t;
+
+void lis3mdl_dipoleField(const lis3mdl_dipole_t *dipole, const float point[3],
+                         float field[3]);
+
+/*!
+ * Tracks one magnet with a Levenberg-Marquardt fit of the dipole model to
+ * each calibrated array frame, starting from the previous frame's answer.
+ * Every frame runs at most a fixed number of iterations, each costing two
+ * passes over the sensors and one 9x9 solve, so the worst case time is set
+ * by the array size and the iteration cap alone.
+ */
+class Adafruit_LIS3MDL_Dipole {
+public:
+  Adafruit_LIS3MDL_Dipole(void);
+
+  void begin(const lis3mdl_dipole_t *initial, bool fitBackground = true,
+             uint8_t maxIterations = 4);
+  void reset(void);
+  bool update(Adafruit_LIS3MDL_Array *array);
+
+  void getState(lis3mdl_dipole_t *state);
+  float getResidual(void);
+
+  /*!
+   *    @brief  Iterations used by the last update()
+   *    @return Count, at most the cap given to begin()
+   */
+  uint8_t getIterations(void) { return _iterations; }
+
+private:
+  float cost(Adafruit_LIS3MDL_Array *array, const float *params);
+  void normalEquations(Adafruit_LIS3MDL_Array *array);
+  void raiseDamping(void);
+
+  float _params[LIS3MDL_DIPOLE_PARAMS];
+  float _initial[LIS3MDL_DIPOLE_PARAMS];
+  float _jtj[LIS3MDL_DIPOLE_PARAMS][LIS3MDL_DIPOLE_PARAMS];
+  float _jtr[LIS3MDL_DIPOLE_PARAMS];
+  float _lambda;
+  float _cost;
+  uint8_t _fitted;
+  uint8_t _maxIterations;
+  uint8_t _iterations;
+  uint8_t _residuals;
+};
+
+#endif
@@ -0,0 +1,210 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Fixed.h
+ *
+ * LIS3MDL with the range and data rate fixed at compile time
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_FIXED_H
+#define ADAFRUIT_LIS3MDL_FIXED_H
+
+#include <Adafruit_LIS3MDL.h>
+
+/*!
+ * An Adafruit_LIS3MDL whose range and data rate are template parameters.
+ * The scale factors, sample period and threshold conversions are
+ * compile-time constants, so read(), readMagneticField() and getEvent()
+ * scale with a constant multiply instead of a lookup and a division on each
+ * call. Call configure() after begin_I2C() or begin_SPI() to apply the
+ * settings; setRange() and setDataRate() are hidden so they cannot drift
+ * from the constants.
+ *
+ *     Adafruit_LIS3MDL_Fixed<LIS3MDL_RANGE_4_GAUSS, LIS3MDL_DATARATE_155_HZ>
+ *         lis3mdl;
+ */
+template <lis3mdl_range_t RANGE, lis3mdl_dataRate_t RATE>
+class Adafruit_LIS3MDL_Fixed : public Adafruit_LIS3MDL {
+public:
+  /** Datasheet sensitivity for RANGE */
+  static constexpr uint16_t lsbPerGauss =
+      RANGE == LIS3MDL_RANGE_16_GAUSS  ? 1711
+      : RANGE == LIS3MDL_RANGE_12_GAUSS ? 2281
+      : RANGE == LIS3MDL_RANGE_8_GAUSS  ? 3421
+                                        : 6842;
+  /** Nanotesla per count in Q8, as used by lis3mdl_countsToNanoTesla() */
+  static constexpr uint16_t nanoTeslaQ8 =
+      (25600000UL + lsbPerGauss / 2) / lsbPerGauss;
+  /** Output rate of RATE in mHz. The FAST_ODR rates have bit 0 set; the
+   * others double from 625 mHz with each step of bits 3:1. */
+  static constexpr uint32_t rate_mHz =
+      !(RATE & 0x01)                    ? 625UL << (RATE >> 1)
+      : RATE == LIS3MDL_DATARATE_155_HZ ? 155000UL
+      : RATE == LIS3MDL_DATARATE_300_HZ ? 300000UL
+      : RATE == LIS3MDL_DATARATE_560_HZ ? 560000UL
+                                        : 1000000UL;
+  /** Largest field INT_THS can hold at RANGE, in nT */
+  static constexpr uint32_t maxThreshold_nT =
+      ((uint32_t)0x7FFF * nanoTeslaQ8 + 128) >> 8;
+  /** Time between samples in us */
+  static constexpr uint32_t period_us = 1000000000UL / rate_mHz;
+#ifndef LIS3MDL_NO_FLOAT
+  /** Gauss per count */
+  static constexpr float gaussPerLSB = 1.0f / lsbPerGauss;
+#endif
+
+  /*!
+   *    @brief  Convert raw counts to nanotesla at RANGE
+   *    @param  counts Raw reading
+   *    @return The field in nT
+   */
+  static constexpr int32_t toNanoTesla(int16_t counts) {
+    return ((int32_t)counts * nanoTeslaQ8 + 128) >> 8;
+  }
+
+  /*!
+   *    @brief  Convert a field to an INT_THS value at RANGE. With a
+   *    constant argument the result is folded at compile time.
+   *    @param  nanoTesla Threshold in nT
+   *    @return Counts, capped at the 15-bit register maximum
+   */
+  static constexpr uint16_t thresholdCounts(uint32_t nanoTesla) {
+    return nanoTesla >= maxThreshold_nT
+               ? 0x7FFF
+               : ((nanoTesla << 8) + nanoTeslaQ8 / 2) / nanoTeslaQ8;
+  }
+
+  /*!
+   *    @brief  Write RANGE and RATE to the sensor
+   *    @return False if RATE is over the limit from setRateLimit()
+   */
+  bool configure(void) {
+    Adafruit_LIS3MDL::setRange(RANGE);
+    return Adafruit_LIS3MDL::setDataRate(RATE);
+  }
+
+  /*!
+   *    @brief  Set the interrupt threshold from a field strength
+   *    @param  nanoTesla Threshold in nT, capped at maxThreshold_nT
+   */
+  void setIntThresholdNanoTesla(uint32_t nanoTesla) {
+    setIntThreshold(thresholdCounts(nanoTesla));
+  }
+
+  /*!
+   *    @brief  Read the XYZ data in one burst into x/y/z, and the gauss
+   *    members unless LIS3MDL_NO_FLOAT is defined
+   */
+  void read(void) {
+    uint8_t buffer[6];
+
+    if (!readRegisters(LIS3MDL_REG_OUT_X_L, buffer, 6))
+      return;
+    x = (int16_t)(buffer[0] | (buffer[1] << 8));
+    y = (int16_t)(buffer[2] | (buffer[3] << 8));
+    z = (int16_t)(buffer[4] | (buffer[5] << 8));
+#ifndef LIS3MDL_NO_FLOAT
+    x_gauss = x * gaussPerLSB;
+    y_gauss = y * gaussPerLSB;
+    z_gauss = z * gaussPerLSB;
+#endif
+  }
+
+  /*!
+   *    @brief  Read magnetic data in nanotesla
+   *    @param  x reference to x axis
+   *    @param  y reference to y axis
+   *    @param  z reference to z axis
+   *    @return 1 if success, 0 if not
+   */
+  int readMagneticField(int32_t &x, int32_t &y, int32_t &z) {
+    uint8_t buffer[6];
+
+    if (!readRegisters(LIS3MDL_REG_OUT_X_L, buffer, 6)) {
+      x = y = z = 0;
+      return 0;
+    }
+    x = toNanoTesla((int16_t)(buffer[0] | (buffer[1] << 8)));
+    y = toNanoTesla((int16_t)(buffer[2] | (buffer[3] << 8)));
+    z = toNanoTesla((int16_t)(buffer[4] | (buffer[5] << 8)));
+    return 1;
+  }
+
+#ifndef LIS3MDL_NO_FLOAT
+  /*!
+   *    @brief  Read magnetic data in microtesla
+   *    @param  x reference to x axis
+   *    @param  y reference to y axis
+   *    @param  z reference to z axis
+   *    @return 1 if success, 0 if not
+   */
+  int readMagneticField(float &x, float &y, float &z) {
+    uint8_t buffer[6];
+
+    if (!readRegisters(LIS3MDL_REG_OUT_X_L, buffer, 6)) {
+      x = y = z = NAN;
+      return 0;
+    }
+    x = (int16_t)(buffer[0] | (buffer[1] << 8)) * (gaussPerLSB * 100);
+    y = (int16_t)(buffer[2] | (buffer[3] << 8)) * (gaussPerLSB * 100);
+    z = (int16_t)(buffer[4] | (buffer[5] << 8)) * (gaussPerLSB * 100);
+    return 1;
+  }
+
+  /*!
+   *    @brief  Read STATUS + XYZ in one burst into a Unified Sensor event,
+   *    scaled by the constant gaussPerLSB instead of a range lookup. The
+   *    gauss members are updated as well.
+   *    @param  event The event to fill, with the field in microtesla and
+   *    the LIS3MDL_FLAG_* bits in reserved0
+   *    @return True on successful read
+   */
+  bool getEvent(sensors_event_t *event) override {
+    lis3mdl_sample_t sample;
+
+    if (!readSample(&sample))
+      return false;
+    x_gauss = sample.x * gaussPerLSB;
+    y_gauss = sample.y * gaussPerLSB;
+    z_gauss = sample.z * gaussPerLSB;
+
+    memset(event, 0, sizeof(sensors_event_t));
+    event->version = sizeof(sensors_event_t);
+    event->sensor_id = _sensorID;
+    event->type = SENSOR_TYPE_MAGNETIC_FIELD;
+    event->timestamp = sample.timestamp;
+    event->reserved0 = sample.flags;
+    event->magnetic.x = sample.x * (gaussPerLSB * 100);
+    event->magnetic.y = sample.y * (gaussPerLSB * 100);
+    event->magnetic.z = sample.z * (gaussPerLSB * 100);
+    return true;
+  }
+
+  /*!
+   *    @brief  Get the magnetic data rate, without a bus read
+   *    @return RATE in Hz
+   */
+  float magneticFieldSampleRate(void) { return rate_mHz / 1000.0f; }
+#endif
+
+private:
+  using Adafruit_LIS3MDL::setDataRate;
+  using Adafruit_LIS3MDL::setRange;
+};
+
+// Definitions for the constants, in case one is bound to a reference
+template <lis3mdl_range_t RANGE, lis3mdl_dataRate_t RATE>
+constexpr uint16_t Adafruit_LIS3MDL_Fixed<RANGE, RATE>::lsbPerGauss;
+template <lis3mdl_range_t RANGE, lis3mdl_dataRate_t RATE>
+constexpr uint16_t Adafruit_LIS3MDL_Fixed<RANGE, RATE>::nanoTeslaQ8;
+template <lis3mdl_range_t RANGE, lis3mdl_dataRate_t RATE>
+constexpr uint32_t Adafruit_LIS3MDL_Fixed<RANGE, RATE>::rate_mHz;
+template <lis3mdl_range_t RANGE, lis3mdl_dataRate_t RATE>
+constexpr uint32_t Adafruit_LIS3MDL_Fixed<RANGE, RATE>::maxThreshold_nT;
+template <lis3mdl_range_t RANGE, lis3mdl_dataRate_t RATE>
+constexpr uint32_t Adafruit_LIS3MDL_Fixed<RANGE, RATE>::period_us;
+#ifndef LIS3MDL_NO_FLOAT
+template <lis3mdl_range_t RANGE, lis3mdl_dataRate_t RATE>
+constexpr float Adafruit_LIS3MDL_Fixed<RANGE, RATE>::gaussPerLSB;
+#endif
+
+#endif
@@ -0,0 +1,192 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Power.cpp
+ *
+ * Estimates the average supply current of the LIS3MDL from its operating
+ * configuration and picks the best-resolution configuration that fits a
+ * current budget.
+ *
+ * The model charges a fixed amount per conversion, proportional to the
+ * conversion time of the X/Y (OM) and Z (OMZ) performance modes, on top of
+ * the power-down floor. The figures are approximate typical values; they
+ * are good enough for battery sizing but will not match an individual part
+ * exactly.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_Power.h"
+
+// Charge per conversion in nC, indexed by lis3mdl_performancemode_t
+static const uint16_t lis3mdl_chargeXY[4] = {350, 625, 1160, 2250};
+static const uint16_t lis3mdl_chargeZ[4] = {175, 310, 580, 1125};
+
+// Normal (non FAST_ODR) data rates, slowest first
+static const lis3mdl_dataRate_t lis3mdl_normalRates[] = {
+    LIS3MDL_DATARATE_0_625_HZ, LIS3MDL_DATARATE_1_25_HZ,
+    LIS3MDL_DATARATE_2_5_HZ,   LIS3MDL_DATARATE_5_HZ,
+    LIS3MDL_DATARATE_10_HZ,    LIS3MDL_DATARATE_20_HZ,
+    LIS3MDL_DATARATE_40_HZ,    LIS3MDL_DATARATE_80_HZ};
+
+// FAST_ODR rate for each performance mode, indexed by mode
+static const lis3mdl_dataRate_t lis3mdl_fastRates[4] = {
+    LIS3MDL_DATARATE_1000_HZ, LIS3MDL_DATARATE_560_HZ,
+    LIS3MDL_DATARATE_300_HZ, LIS3MDL_DATARATE_155_HZ};
+
+/**************************************************************************/
+/*!
+    @brief Charge drawn by one X/Y/Z conversion
+    @param mode X/Y performance mode (OM bits)
+    @param modeZ Z performance mode (OMZ bits)
+    @returns Charge per conversion in nC
+*/
+/**************************************************************************/
+uint32_t lis3mdl_conversionCharge(lis3mdl_performancemode_t mode,
+                                  lis3mdl_performancemode_t modeZ) {
+  return (uint32_t)lis3mdl_chargeXY[mode & 0x03] +
+         lis3mdl_chargeZ[modeZ & 0x03];
+}
+
+/**************************************************************************/
+/*!
+    @brief Estimate the average supply current of a configuration
+    @param config The configuration to estimate, usually filled in by
+    Adafruit_LIS3MDL::getPowerConfig()
+    @returns Average current in nA
+*/
+/**************************************************************************/
+uint32_t lis3mdl_estimateCurrent(const lis3mdl_power_config_t *config) {
+  uint32_t rate_mHz = 0;
+  uint32_t charge;
+
+  if (config->lowPower) {
+    // LP forces the slowest rate and the minimum number of averages
+    charge = lis3mdl_conversionCharge(LIS3MDL_LOWPOWERMODE,
+                                      LIS3MDL_LOWPOWERMODE);
+  } else {
+    charge = lis3mdl_conversionCharge(config->performanceMode,
+                                      config->performanceModeZ);
+  }
+
+  switch (config->operationMode) {
+  case LIS3MDL_CONTINUOUSMODE:
+    rate_mHz = config->lowPower
+                   ? lis3mdl_dataRateToMilliHz(LIS3MDL_DATARATE_0_625_HZ)
+                   : lis3mdl_dataRateToMilliHz(config->dataRate);
+    break;
+  case LIS3MDL_SINGLEMODE:
+    rate_mHz = config->singleShotRate_mHz;
+    break;
+  default:
+    break;
+  }
+
+  // rate_mHz * charge / 1000 without overflowing 32 bits
+  return LIS3MDL_POWERDOWN_CURRENT_NA + (rate_mHz / 1000) * charge +
+         (rate_mHz % 1000) * charge / 1000;
+}
+
+/**************************************************************************/
+/*!
+    @brief Find the best-resolution configuration that fits a current budget
+    @param budget_nA Maximum average current in nA
+    @param minRate_mHz Lowest acceptable sample rate in mHz
+    @param config Filled in with the chosen configuration. If nothing fits,
+    the lowest-current configuration that meets minRate_mHz is returned.
+    @returns True if the chosen configuration fits the budget
+*/
+/**************************************************************************/
+bool lis3mdl_planPower(uint32_t budget_nA, uint32_t minRate_mHz,
+                       lis3mdl_power_config_t *config) {
+  lis3mdl_power_config_t candidate;
+  uint32_t bestCurrent = 0xFFFFFFFF;
+
+  // Walk from ultra-high down to low power, stopping at the first mode with
+  // a configuration inside the budget
+  for (int8_t mode = LIS3MDL_ULTRAHIGHMODE; mode >= LIS3MDL_LOWPOWERMODE;
+       mode--) {
+    lis3mdl_dataRate_t fastRate = lis3mdl_fastRates[mode];
+    if (lis3mdl_dataRateToMilliHz(fastRate) < minRate_mHz)
+      continue; // this mode cannot convert fast enough
+
+    candidate.performanceMode = (lis3mdl_performancemode_t)mode;
+    candidate.performanceModeZ = (lis3mdl_performancemode_t)mode;
+    candidate.lowPower = false;
+
+    // Continuous at the slowest hardware rate that meets the requirement
+    candidate.operationMode = LIS3MDL_CONTINUOUSMODE;
+    candidate.singleShotRate_mHz = 0;
+    candidate.dataRate = fastRate;
+    for (uint8_t i = 0;
+         i < sizeof(lis3mdl_normalRates) / sizeof(lis3mdl_normalRates[0]);
+         i++) {
+      if (lis3mdl_dataRateToMilliHz(lis3mdl_normalRates[i]) >= minRate_mHz) {
+        candidate.dataRate = lis3mdl_normalRates[i];
+        break;
+      }
+    }
+    uint32_t current = lis3mdl_estimateCurrent(&candidate);
+    if (current < bestCurrent) {
+      bestCurrent = current;
+      *config = candidate;
+    }
+
+    // Single-shot triggered at exactly the requested rate
+    candidate.operationMode = LIS3MDL_SINGLEMODE;
+    candidate.singleShotRate_mHz = minRate_mHz;
+    current = lis3mdl_estimateCurrent(&candidate);
+    if (current < bestCurrent) {
+      bestCurrent = current;
+      *config = candidate;
+    }
+
+    if (bestCurrent <= budget_nA)
+      return true;
+  }
+
+  // Last resort: the LP bit, which caps the rate at 0.625 Hz
+  if (minRate_mHz <= lis3mdl_dataRateToMilliHz(LIS3MDL_DATARATE_0_625_HZ)) {
+    candidate.operationMode = LIS3MDL_CONTINUOUSMODE;
+    candidate.performanceMode = LIS3MDL_LOWPOWERMODE;
+    candidate.performanceModeZ = LIS3MDL_LOWPOWERMODE;
+    candidate.dataRate = LIS3MDL_DATARATE_0_625_HZ;
+    candidate.lowPower = true;
+    candidate.singleShotRate_mHz = 0;
+    uint32_t current = lis3mdl_estimateCurrent(&candidate);
+    if (current < bestCurrent) {
+      bestCurrent = current;
+      *config = candidate;
+    }
+  }
+  return bestCurrent <= budget_nA;
+}
+
+/**************************************************************************/
+/*!
+    @brief Convert a battery lifetime target into a current budget
+    @param capacity_mAh Usable battery capacity in mAh
+    @param hours Required lifetime in hours
+    @returns Average current budget in nA
+*/
+/**************************************************************************/
+uint32_t lis3mdl_budgetForLifetime(uint32_t capacity_mAh, uint32_t hours) {
+  if (hours == 0)
+    return 0xFFFFFFFF;
+  uint64_t budget = (uint64_t)capacity_mAh * 1000000UL / hours;
+  return budget > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)budget;
+}
+
+/**************************************************************************/
+/*!
+    @brief Estimate battery lifetime at a given average current
+    @param capacity_mAh Usable battery capacity in mAh
+    @param current_nA Average current in nA
+    @returns Lifetime in hours
+*/
+/**************************************************************************/
+uint32_t lis3mdl_lifetimeHours(uint32_t capacity_mAh, uint32_t current_nA) {
+  if (current_nA == 0)
+    return 0xFFFFFFFF;
+  uint64_t hours = (uint64_t)capacity_mAh * 1000000UL / current_nA;
+  return hours > 0xFFFFFFFF ? 0xFFFFFFFF : (uint32_t)hours;
+}
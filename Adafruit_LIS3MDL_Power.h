@@ -0,0 +1,24 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Power.h
+ *
+ * Current consumption model and power budget planner for the LIS3MDL
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_POWER_H
+#define ADAFRUIT_LIS3MDL_POWER_H
+
+#include <Adafruit_LIS3MDL.h>
+
+/** Typical power-down supply current in nA */
+#define LIS3MDL_POWERDOWN_CURRENT_NA 1000
+
+uint32_t lis3mdl_estimateCurrent(const lis3mdl_power_config_t *config);
+uint32_t lis3mdl_conversionCharge(lis3mdl_performancemode_t mode,
+                                  lis3mdl_performancemode_t modeZ);
+bool lis3mdl_planPower(uint32_t budget_nA, uint32_t minRate_mHz,
+                       lis3mdl_power_config_t *config);
+uint32_t lis3mdl_budgetForLifetime(uint32_t capacity_mAh, uint32_t hours);
+uint32_t lis3mdl_lifetimeHours(uint32_t capacity_mAh, uint32_t current_nA);
+
+#endif
@@ -0,0 +1,240 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Production.cpp
+ *
+ * End-of-line test: identity, register readback, self-test, noise and the
+ * INT pin, each timed against its own budget. Every wait polls STATUS or
+ * the pin instead of sleeping a fixed time, and the sensor's configuration
+ * is restored when the test ends.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_Production.h"
+
+#define LIS3MDL_TEST_NOISE_SAMPLES 16 ///< Samples in the noise estimate
+
+// Bits the readback step exercises in CTRL_REG1..5. REBOOT, SOFT_RST, SIM
+// and BLE are left alone since flipping them would break the bus or data.
+// Of MD1:0 only MD1 is exercised, with MD0 held at 0: MD = 01 would start
+// a single conversion, after which the part sets MD back to 11 by itself.
+static const uint8_t lis3mdl_ctrlMask[5] = {0xFF, 0x60, 0x22, 0x0C, 0xC0};
+// INT_CFG without IEN, so INT stays quiet; INT_THS without the sign bit
+static const uint8_t lis3mdl_intCfgMask = 0xE6;
+static const uint8_t lis3mdl_intThsMask[2] = {0xFF, 0x7F};
+
+static const uint32_t lis3mdl_testBudget[LIS3MDL_TEST_STEPS] = {
+    LIS3MDL_TEST_WHOAMI_US, LIS3MDL_TEST_REGISTERS_US,
+    LIS3MDL_TEST_SELFTEST_US, LIS3MDL_TEST_NOISE_US, LIS3MDL_TEST_INTPIN_US};
+
+// Poll for a fresh sample until the deadline
+static bool lis3mdl_testSample(Adafruit_LIS3MDL *sensor,
+                               lis3mdl_sample_t *sample, uint32_t start,
+                               uint32_t budget_us) {
+  do {
+    if (!sensor->readSample(sample))
+      return false;
+    if (sample->status & 0x08) // ZYXDA
+      return true;
+  } while (micros() - start < budget_us);
+  return false;
+}
+
+// Poll the INT pin for a level until the deadline
+static bool lis3mdl_testPin(bool (*readIntPin)(void), bool level,
+                            uint32_t start) {
+  do {
+    if (readIntPin() == level)
+      return true;
+  } while (micros() - start < LIS3MDL_TEST_INTPIN_US);
+  return false;
+}
+
+// Write one pattern to every writable register and read it back
+static bool lis3mdl_testPattern(Adafruit_LIS3MDL *sensor, const uint8_t *ctrl,
+                                const uint8_t *ints, uint8_t pattern,
+                                lis3mdl_production_t *result) {
+  uint8_t write[5], read[5];
+
+  for (uint8_t i = 0; i < 5; i++)
+    write[i] = (ctrl[i] & ~lis3mdl_ctrlMask[i]) |
+               (pattern & lis3mdl_ctrlMask[i]);
+  write[2] &= ~0x01; // MD0, so MD is 00 or 10 (power-down)
+  if (!sensor->writeRegisters(LIS3MDL_REG_CTRL_REG1, write, 5) ||
+      !sensor->readRegisters(LIS3MDL_REG_CTRL_REG1, read, 5))
+    return false;
+  for (uint8_t i = 0; i < 5; i++) {
+    if ((read[i] ^ write[i]) & lis3mdl_ctrlMask[i]) {
+      result->badRegister = LIS3MDL_REG_CTRL_REG1 + i;
+      return false;
+    }
+  }
+
+  write[0] = (ints[0] & ~lis3mdl_intCfgMask) | (pattern & lis3mdl_intCfgMask);
+  write[1] = pattern & lis3mdl_intThsMask[0];
+  write[2] = pattern & lis3mdl_intThsMask[1];
+  if (!sensor->writeRegisters(LIS3MDL_REG_INT_CFG, write, 1) ||
+      !sensor->writeRegisters(LIS3MDL_REG_INT_THS_L, write + 1, 2) ||
+      !sensor->readRegisters(LIS3MDL_REG_INT_CFG, read, 4))
+    return false;
+  if ((read[0] ^ write[0]) & lis3mdl_intCfgMask)
+    result->badRegister = LIS3MDL_REG_INT_CFG;
+  else if (read[2] != write[1])
+    result->badRegister = LIS3MDL_REG_INT_THS_L;
+  else if (read[3] != write[2])
+    result->badRegister = LIS3MDL_REG_INT_THS_L + 1;
+  return result->badRegister == 0;
+}
+
+// Integer square root, rounded down
+static uint16_t lis3mdl_isqrt(uint32_t value) {
+  uint32_t root = 0, bit = 1UL << 30;
+
+  while (bit > value)
+    bit >>= 2;
+  while (bit) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return root;
+}
+
+// RMS noise per axis at 4 gauss, 155 Hz ultra-high performance. Sums are
+// taken around the first sample in integers; deviations are clipped well
+// past the limits so the squares cannot overflow.
+static bool lis3mdl_testNoise(Adafruit_LIS3MDL *sensor,
+                              lis3mdl_production_t *result, uint32_t start) {
+  uint8_t config[5] = {0x62, 0x00, 0x00, 0x0C, 0x00};
+  int32_t sum[3] = {0, 0, 0};
+  uint32_t sumSq[3] = {0, 0, 0};
+  int16_t origin[3] = {0, 0, 0};
+  lis3mdl_sample_t sample;
+
+  if (!sensor->writeRegisters(LIS3MDL_REG_CTRL_REG1, config, 5))
+    return false;
+  for (int8_t i = -1; i < LIS3MDL_TEST_NOISE_SAMPLES; i++) {
+    if (!lis3mdl_testSample(sensor, &sample, start, LIS3MDL_TEST_NOISE_US))
+      return false;
+    if (i < 0) // first conversion after the settings change
+      continue;
+    int16_t value[3] = {sample.x, sample.y, sample.z};
+    for (uint8_t a = 0; a < 3; a++) {
+      if (i == 0)
+        origin[a] = value[a];
+      int32_t d = (int32_t)value[a] - origin[a];
+      if (d > 4095)
+        d = 4095;
+      else if (d < -4095)
+        d = -4095;
+      sum[a] += d;
+      sumSq[a] += (uint32_t)(d * d);
+    }
+  }
+
+  bool pass = true;
+  for (uint8_t a = 0; a < 3; a++) {
+    // N * sumSq - sum^2 is N^2 times the variance, and fits in 32 bits
+    uint32_t s = (uint32_t)(sum[a] < 0 ? -sum[a] : sum[a]);
+    uint16_t root =
+        lis3mdl_isqrt(LIS3MDL_TEST_NOISE_SAMPLES * sumSq[a] - s * s);
+    result->noise[a] = (root + LIS3MDL_TEST_NOISE_SAMPLES / 2) /
+                       LIS3MDL_TEST_NOISE_SAMPLES;
+    uint16_t limit = a < 2 ? LIS3MDL_TEST_NOISE_XY : LIS3MDL_TEST_NOISE_Z;
+    // No noise at all means the output is stuck
+    pass = pass && result->noise[a] > 0 && result->noise[a] <= limit;
+  }
+  return pass;
+}
+
+// INT must idle low, rise on a threshold event, and follow IEA
+static bool lis3mdl_testIntPin(Adafruit_LIS3MDL *sensor,
+                               bool (*readIntPin)(void), uint32_t start) {
+  uint8_t cfg = 0x0C, ths[2] = {0x01, 0x00}; // active high, disabled
+
+  if (!sensor->writeRegisters(LIS3MDL_REG_INT_THS_L, ths, 2) ||
+      !sensor->writeRegisters(LIS3MDL_REG_INT_CFG, &cfg, 1) ||
+      !lis3mdl_testPin(readIntPin, false, start))
+    return false;
+
+  cfg = 0xED; // X/Y/Z over 1 count, active high, enabled
+  if (!sensor->writeRegisters(LIS3MDL_REG_INT_CFG, &cfg, 1) ||
+      !lis3mdl_testPin(readIntPin, true, start))
+    return false;
+
+  cfg = 0xE9; // same event, active low
+  return sensor->writeRegisters(LIS3MDL_REG_INT_CFG, &cfg, 1) &&
+         lis3mdl_testPin(readIntPin, false, start);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Run the production test on a sensor whose bus is set up. Steps
+    run in the order of the LIS3MDL_TEST_* bits; if WHO_AM_I fails the rest
+    are skipped. Each step is timed with micros() and flagged in slow when
+    it overruns its LIS3MDL_TEST_*_US budget.
+    @param  sensor The sensor, after begin_I2C() or begin_SPI()
+    @param  result Where to store the record
+    @param  readIntPin Returns true when INT is high, for example a lambda
+    around digitalRead(); NULL skips the INT step
+    @returns True if no step failed or ran over budget
+*/
+/**************************************************************************/
+bool lis3mdl_productionTest(Adafruit_LIS3MDL *sensor,
+                            lis3mdl_production_t *result,
+                            bool (*readIntPin)(void)) {
+  uint8_t ctrl[5], ints[4];
+  uint32_t start;
+
+  memset(result, 0, sizeof(*result));
+
+  start = micros();
+  if (!sensor->readRegisters(LIS3MDL_REG_WHO_AM_I, &result->whoAmI, 1) ||
+      result->whoAmI != 0x3D)
+    result->failed |= LIS3MDL_TEST_WHOAMI;
+  result->time_us[0] = micros() - start;
+  if (result->failed) {
+    result->skipped = ~LIS3MDL_TEST_WHOAMI & ((1 << LIS3MDL_TEST_STEPS) - 1);
+    return false;
+  }
+
+  start = micros();
+  bool saved = sensor->readRegisters(LIS3MDL_REG_CTRL_REG1, ctrl, 5) &&
+               sensor->readRegisters(LIS3MDL_REG_INT_CFG, ints, 4);
+  if (!saved || !lis3mdl_testPattern(sensor, ctrl, ints, 0x55, result) ||
+      !lis3mdl_testPattern(sensor, ctrl, ints, 0xAA, result))
+    result->failed |= LIS3MDL_TEST_REGISTERS;
+  sensor->writeRegisters(LIS3MDL_REG_CTRL_REG1, ctrl, 5);
+  sensor->writeRegisters(LIS3MDL_REG_INT_CFG, ints, 1);
+  sensor->writeRegisters(LIS3MDL_REG_INT_THS_L, ints + 2, 2);
+  result->time_us[1] = micros() - start;
+
+  start = micros();
+  if (!sensor->runSelfTest(&result->selfTest))
+    result->failed |= LIS3MDL_TEST_SELFTEST;
+  result->time_us[2] = micros() - start;
+
+  start = micros();
+  if (!lis3mdl_testNoise(sensor, result, start))
+    result->failed |= LIS3MDL_TEST_NOISE;
+  result->time_us[3] = micros() - start;
+
+  start = micros();
+  if (!readIntPin)
+    result->skipped |= LIS3MDL_TEST_INTPIN;
+  else if (!lis3mdl_testIntPin(sensor, readIntPin, start))
+    result->failed |= LIS3MDL_TEST_INTPIN;
+  sensor->writeRegisters(LIS3MDL_REG_CTRL_REG1, ctrl, 5);
+  sensor->writeRegisters(LIS3MDL_REG_INT_CFG, ints, 1);
+  sensor->writeRegisters(LIS3MDL_REG_INT_THS_L, ints + 2, 2);
+  result->time_us[4] = micros() - start;
+
+  for (uint8_t i = 0; i < LIS3MDL_TEST_STEPS; i++)
+    if (result->time_us[i] > lis3mdl_testBudget[i])
+      result->slow |= 1 << i;
+  return !result->failed && !result->slow;
+}
@@ -0,0 +1,61 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Production.h
+ *
+ * Fast end-of-line test for boards carrying an LIS3MDL
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_PRODUCTION_H
+#define ADAFRUIT_LIS3MDL_PRODUCTION_H
+
+#include <Adafruit_LIS3MDL.h>
+
+#define LIS3MDL_TEST_WHOAMI 0x01    ///< WHO_AM_I was not 0x3D
+#define LIS3MDL_TEST_REGISTERS 0x02 ///< A writable register did not read back
+#define LIS3MDL_TEST_SELFTEST 0x04  ///< Self-test response out of limits
+#define LIS3MDL_TEST_NOISE 0x08     ///< Output noise too high, or stuck
+#define LIS3MDL_TEST_INTPIN 0x10    ///< INT did not follow the interrupt
+#define LIS3MDL_TEST_STEPS 5        ///< Number of test steps
+
+// Per-step time budgets in us. Define before including to change.
+#ifndef LIS3MDL_TEST_WHOAMI_US
+#define LIS3MDL_TEST_WHOAMI_US 5000 ///< One register read
+#endif
+#ifndef LIS3MDL_TEST_REGISTERS_US
+#define LIS3MDL_TEST_REGISTERS_US 30000 ///< Two patterns, plus restore
+#endif
+#ifndef LIS3MDL_TEST_SELFTEST_US
+#define LIS3MDL_TEST_SELFTEST_US 250000 ///< 12 conversions at 80 Hz
+#endif
+#ifndef LIS3MDL_TEST_NOISE_US
+#define LIS3MDL_TEST_NOISE_US 200000 ///< 17 conversions at 155 Hz
+#endif
+#ifndef LIS3MDL_TEST_INTPIN_US
+#define LIS3MDL_TEST_INTPIN_US 50000 ///< Up to two conversions at 155 Hz
+#endif
+
+// Noise limits in counts RMS at 4 gauss, three times the datasheet figures
+#ifndef LIS3MDL_TEST_NOISE_XY
+#define LIS3MDL_TEST_NOISE_XY 66 ///< X and Y noise limit
+#endif
+#ifndef LIS3MDL_TEST_NOISE_Z
+#define LIS3MDL_TEST_NOISE_Z 84 ///< Z noise limit
+#endif
+
+/** Outcome of lis3mdl_productionTest() */
+typedef struct {
+  uint8_t failed;                       ///< LIS3MDL_TEST_* bits of failed steps
+  uint8_t slow;                         ///< LIS3MDL_TEST_* bits over budget
+  uint8_t skipped;                      ///< LIS3MDL_TEST_* bits not run
+  uint8_t whoAmI;                       ///< WHO_AM_I value read
+  uint8_t badRegister;                  ///< First register not reading back
+  lis3mdl_selftest_t selfTest;          ///< Self-test detail
+  uint16_t noise[3];                    ///< X/Y/Z RMS counts at 4 gauss
+  uint32_t time_us[LIS3MDL_TEST_STEPS]; ///< Time taken by each step
+} lis3mdl_production_t;
+
+bool lis3mdl_productionTest(Adafruit_LIS3MDL *sensor,
+                            lis3mdl_production_t *result,
+                            bool (*readIntPin)(void) = NULL);
+
+#endif
@@ -0,0 +1,139 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Resampler.cpp
+ *
+ * The output grid advances by a period held as whole microseconds plus a
+ * 16-bit fraction, so rates that do not divide a second evenly do not
+ * drift. Each output value is the two neighbouring inputs blended with a
+ * Q14 weight. Input timestamps should be sample times rather than poll
+ * times, for example from a data-ready interrupt or the aligner's tracked
+ * clock, since interpolation passes timing jitter straight into the data.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_Resampler.h"
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a resampler for 100 Hz output
+*/
+/**************************************************************************/
+Adafruit_LIS3MDL_Resampler::Adafruit_LIS3MDL_Resampler(void) {
+  begin(100000);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the output rate and start over
+    @param  outputRate_mHz Output rate in mHz, for example 200000 for 200 Hz
+    @param  maxGap_us Longest input gap to interpolate across. After a
+    longer gap the output grid restarts at the next input.
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Resampler::begin(uint32_t outputRate_mHz,
+                                       uint32_t maxGap_us) {
+  if (!outputRate_mHz)
+    outputRate_mHz = 1;
+  _period_us = 1000000000UL / outputRate_mHz;
+  _periodFrac = ((uint64_t)(1000000000UL % outputRate_mHz) << 16) /
+                outputRate_mHz;
+  _maxGap_us = maxGap_us;
+  _skipped = 0;
+  reset();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Drop the stored inputs; the grid restarts at the next input
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Resampler::reset(void) { _stored = 0; }
+
+/**************************************************************************/
+/*!
+    @brief  Feed the next hardware sample. Call getSample() until it
+    returns false after each one; grid points that were not collected
+    before the next input are skipped and counted by getSkipped().
+    @param  sample The sample, as from readSample()
+    @param  timestamp_us When it was measured, on the micros() clock
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Resampler::addSample(const lis3mdl_sample_t *sample,
+                                           uint32_t timestamp_us) {
+  if (_stored && (timestamp_us - _curr_us > _maxGap_us ||
+                  (int32_t)(timestamp_us - _curr_us) <= 0))
+    _stored = 0; // gap or time going backwards
+
+  memcpy(_prev, _curr, sizeof(_prev));
+  _prev_us = _curr_us;
+  _curr[0] = sample->x;
+  _curr[1] = sample->y;
+  _curr[2] = sample->z;
+  _curr_us = timestamp_us;
+  _currMillis = sample->timestamp;
+  _status = sample->status;
+  _flags = sample->flags;
+
+  int32_t behind = _prev_us - _next_us;
+  if (_stored && behind > 0) {
+    // Outputs were not drained: move the grid up to the older input, or
+    // the interpolation weight in getSample() would wrap
+    uint64_t period = ((uint64_t)_period_us << 16) | _periodFrac;
+    uint64_t late = ((uint64_t)behind << 16) - _nextFrac;
+    uint32_t steps = (late + period - 1) / period;
+    uint64_t next = _nextFrac + steps * period;
+    _next_us += (uint32_t)(next >> 16);
+    _nextFrac = (uint16_t)next;
+    _skipped += steps;
+  }
+  if (!_stored) {
+    _next_us = timestamp_us;
+    _nextFrac = 0;
+  }
+  if (_stored < 2)
+    _stored++;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Produce the next output sample if the inputs cover its time
+    @param  sample Where to store it. The status and flags are those of the
+    newer input and the timestamp is the output time on the millis() clock.
+    @param  timestamp_us Where to store the output time on the micros()
+    clock, or NULL
+    @returns True if a sample was produced
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_Resampler::getSample(lis3mdl_sample_t *sample,
+                                           uint32_t *timestamp_us) {
+  if (!_stored || (int32_t)(_next_us - _curr_us) > 0)
+    return false;
+
+  if (_stored < 2) {
+    // The first output sits exactly on the first input
+    sample->x = _curr[0];
+    sample->y = _curr[1];
+    sample->z = _curr[2];
+  } else {
+    // Q14 weight of the newer input. The grid is past the older input,
+    // since every earlier grid point has been produced.
+    uint32_t since = _next_us - _prev_us, span = _curr_us - _prev_us;
+    int32_t weight = (int32_t)(((uint64_t)since << 14) / span);
+    int16_t *out[3] = {&sample->x, &sample->y, &sample->z};
+    for (uint8_t a = 0; a < 3; a++) {
+      int32_t from = _prev[a], to = _curr[a];
+      *out[a] = (int16_t)(from + (((to - from) * weight + 8192) >> 14));
+    }
+  }
+  sample->status = _status;
+  sample->flags = _flags;
+  sample->timestamp = _currMillis - (_curr_us - _next_us) / 1000;
+  if (timestamp_us)
+    *timestamp_us = _next_us;
+
+  uint32_t frac = (uint32_t)_nextFrac + _periodFrac;
+  _next_us += _period_us + (frac >> 16);
+  _nextFrac = frac;
+  return true;
+}
@@ -0,0 +1,54 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Resampler.h
+ *
+ * Converts an LIS3MDL sample stream to an arbitrary output rate
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_RESAMPLER_H
+#define ADAFRUIT_LIS3MDL_RESAMPLER_H
+
+#include <Adafruit_LIS3MDL.h>
+
+/*!
+ * Linear interpolation from timestamped hardware samples onto a uniform
+ * output grid, in integer arithmetic. An output sample is released as soon
+ * as the first input after its grid time arrives, so the added latency is
+ * at most one input period. Run the sensor at the next data rate above the
+ * output rate, for example 300 Hz for a 200 Hz consumer.
+ */
+class Adafruit_LIS3MDL_Resampler {
+public:
+  Adafruit_LIS3MDL_Resampler(void);
+
+  void begin(uint32_t outputRate_mHz, uint32_t maxGap_us = 100000);
+  void reset(void);
+  void addSample(const lis3mdl_sample_t *sample, uint32_t timestamp_us);
+  bool getSample(lis3mdl_sample_t *sample, uint32_t *timestamp_us = NULL);
+
+  /*!
+   *    @brief  Output samples dropped because getSample() was not called
+   *    until it returned false before the next input
+   *    @return Count since begin()
+   */
+  uint32_t getSkipped(void) { return _skipped; }
+
+private:
+  int16_t _prev[3];
+  int16_t _curr[3];
+  uint32_t _prev_us;
+  uint32_t _curr_us;
+  uint32_t _currMillis;
+  uint8_t _status;
+  uint8_t _flags;
+  uint8_t _stored;
+
+  uint32_t _next_us;
+  uint16_t _nextFrac; // 1/65536 us
+  uint32_t _period_us;
+  uint16_t _periodFrac;
+  uint32_t _maxGap_us;
+  uint32_t _skipped;
+};
+
+#endif
@@ -0,0 +1,575 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Scene.cpp
+ *
+ * Synthetic field scenes for benchmarking calibration, heading and
+ * localization code, and a register-level emulator on top of them.
+ *
+ * The world frame is north, east, down. The sensor sits at the origin and
+ * turns at constant roll, pitch and yaw rates; magnets move in straight
+ * lines. The field in the sensor frame passes through soft iron (a 3x3
+ * matrix), hard iron (an offset), the self-test field when ST is set and
+ * Gaussian noise, then is quantized with the range's sensitivity and
+ * clamped at its full scale.
+ *
+ * Noise is the datasheet's ultra-high performance figure (3.2 mgauss RMS on
+ * X and Y, 4.1 on Z), scaled by the square root of the averaging ratio for
+ * the lower modes. Each noise value is derived from a hash of the seed, the
+ * sample and the axis rather than from a running generator, so any sample
+ * can be regenerated on its own.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_Scene.h"
+
+// Noise in ugauss RMS, indexed by lis3mdl_performancemode_t
+static const uint16_t lis3mdl_noiseXY[4] = {9051, 6400, 4525, 3200};
+static const uint16_t lis3mdl_noiseZ[4] = {11597, 8200, 5798, 4100};
+
+// FAST_ODR rate in mHz, indexed by the OM bits
+static const uint32_t lis3mdl_fastRate[4] = {1000000, 560000, 300000,
+                                             155000};
+
+// Self-test field in gauss, inside the datasheet's limits at 12 gauss
+static const float lis3mdl_selfTestField[3] = {1.5f, 1.5f, 0.5f};
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a scene with the default setup of begin()
+    @param  seed Noise seed
+*/
+/**************************************************************************/
+Adafruit_LIS3MDL_Scene::Adafruit_LIS3MDL_Scene(uint32_t seed) { begin(seed); }
+
+/**************************************************************************/
+/*!
+    @brief  Reset to a level, still sensor in a 0.2 gauss north, 0.45 gauss
+    down field, with no distortion, no magnets, noise on, and the emulated
+    registers at their power-on values
+    @param  seed Noise seed
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::begin(uint32_t seed) {
+  _seed = seed;
+  _next = 0;
+  setEarthField(0.2f, 0, 0.45f);
+  memset(_attitude, 0, sizeof(_attitude));
+  memset(_rate, 0, sizeof(_rate));
+  memset(_hardIron, 0, sizeof(_hardIron));
+  memset(_softIron, 0, sizeof(_softIron));
+  _softIron[0][0] = _softIron[1][1] = _softIron[2][2] = 1;
+  _numDipoles = 0;
+  _noise = true;
+  _haveOrigin = false;
+  _key = 0;
+  resetRegisters();
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the background field in the world frame
+    @param  north North component in gauss
+    @param  east East component in gauss
+    @param  down Downward component in gauss
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::setEarthField(float north, float east,
+                                           float down) {
+  _earth[0] = north;
+  _earth[1] = east;
+  _earth[2] = down;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the sensor's orientation at time zero
+    @param  roll Rotation about X in radians
+    @param  pitch Rotation about Y in radians
+    @param  yaw Rotation about Z (heading) in radians
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::setAttitude(float roll, float pitch, float yaw) {
+  _attitude[0] = roll;
+  _attitude[1] = pitch;
+  _attitude[2] = yaw;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set how fast the orientation angles change
+    @param  rollRate Roll rate in radians per second
+    @param  pitchRate Pitch rate in radians per second
+    @param  yawRate Yaw rate in radians per second
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::setRotationRate(float rollRate, float pitchRate,
+                                             float yawRate) {
+  _rate[0] = rollRate;
+  _rate[1] = pitchRate;
+  _rate[2] = yawRate;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the hard iron offset, added in the sensor frame
+    @param  x X offset in gauss
+    @param  y Y offset in gauss
+    @param  z Z offset in gauss
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::setHardIron(float x, float y, float z) {
+  _hardIron[0] = x;
+  _hardIron[1] = y;
+  _hardIron[2] = z;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the soft iron distortion, applied in the sensor frame
+    before the hard iron offset
+    @param  matrix Row-major distortion matrix, identity for none
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::setSoftIron(const float matrix[3][3]) {
+  memcpy(_softIron, matrix, sizeof(_softIron));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Add a magnet moving in a straight line
+    @param  dipole Position at time zero in metres, relative to the sensor
+    in the world frame, and moment in A m^2; the background is ignored
+    @param  velocity Velocity in metres per second, or NULL if it is still
+    @returns The magnet's index, or -1 if the scene is full
+*/
+/**************************************************************************/
+int8_t Adafruit_LIS3MDL_Scene::addDipole(const lis3mdl_dipole_t *dipole,
+                                         const float velocity[3]) {
+  if (_numDipoles >= LIS3MDL_SCENE_MAX_DIPOLES)
+    return -1;
+
+  _dipoles[_numDipoles] = *dipole;
+  memset(_dipoles[_numDipoles].background, 0, 3 * sizeof(float));
+  for (uint8_t a = 0; a < 3; a++)
+    _velocity[_numDipoles][a] = velocity ? velocity[a] : 0;
+  return _numDipoles++;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Turn sensor noise on or off
+    @param  enable False for noise-free, purely quantized samples
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::setNoise(bool enable) { _noise = enable; }
+
+/**************************************************************************/
+/*!
+    @brief  Set the emulated full scale range
+    @param  range Enumerated lis3mdl_range_t
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::setRange(lis3mdl_range_t range) {
+  _regs[LIS3MDL_REG_CTRL_REG2] =
+      (_regs[LIS3MDL_REG_CTRL_REG2] & ~0x60) | ((range & 0x03) << 5);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the emulated data rate. The FAST_ODR rates also set the X/Y
+    performance mode they belong to, as on the real part.
+    @param  dataRate Enumerated lis3mdl_dataRate_t
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::setDataRate(lis3mdl_dataRate_t dataRate) {
+  uint8_t ctrl1 = (_regs[LIS3MDL_REG_CTRL_REG1] & ~0x1E) | (dataRate << 1);
+
+  if (dataRate & 0x01) {
+    for (uint8_t om = 0; om < 4; om++)
+      if (lis3mdl_fastRate[om] == lis3mdl_dataRateToMilliHz(dataRate))
+        ctrl1 = (ctrl1 & ~0x60) | (om << 5);
+  }
+  _regs[LIS3MDL_REG_CTRL_REG1] = ctrl1;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Set the emulated performance modes, which set the noise level
+    @param  mode X/Y performance mode (OM bits)
+    @param  modeZ Z performance mode (OMZ bits)
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::setPerformanceMode(
+    lis3mdl_performancemode_t mode, lis3mdl_performancemode_t modeZ) {
+  _regs[LIS3MDL_REG_CTRL_REG1] =
+      (_regs[LIS3MDL_REG_CTRL_REG1] & ~0x60) | ((mode & 0x03) << 5);
+  _regs[LIS3MDL_REG_CTRL_REG4] =
+      (_regs[LIS3MDL_REG_CTRL_REG4] & ~0x0C) | ((modeZ & 0x03) << 2);
+}
+
+/**************************************************************************/
+/*!
+    @brief  The emulated full scale range
+    @returns Enumerated lis3mdl_range_t
+*/
+/**************************************************************************/
+lis3mdl_range_t Adafruit_LIS3MDL_Scene::getRange(void) {
+  return (lis3mdl_range_t)((_regs[LIS3MDL_REG_CTRL_REG2] >> 5) & 0x03);
+}
+
+/**************************************************************************/
+/*!
+    @brief  The emulated output data rate, taking FAST_ODR and LP into
+    account
+    @returns Rate in mHz
+*/
+/**************************************************************************/
+uint32_t Adafruit_LIS3MDL_Scene::getRateMilliHz(void) {
+  uint8_t ctrl1 = _regs[LIS3MDL_REG_CTRL_REG1];
+
+  if (_regs[LIS3MDL_REG_CTRL_REG3] & 0x20) // LP
+    return lis3mdl_dataRateToMilliHz(LIS3MDL_DATARATE_0_625_HZ);
+  if (ctrl1 & 0x02) // FAST_ODR
+    return lis3mdl_fastRate[(ctrl1 >> 5) & 0x03];
+  return lis3mdl_dataRateToMilliHz((lis3mdl_dataRate_t)((ctrl1 >> 1) & 0x0E));
+}
+
+/**************************************************************************/
+/*!
+    @brief  Gaussian noise from a hash, so it is repeatable per sample
+    @param  key Sample key
+    @param  axis 0 to 2
+    @returns A standard normal value
+*/
+/**************************************************************************/
+float Adafruit_LIS3MDL_Scene::gaussian(uint32_t key, uint8_t axis) {
+  float u[2];
+
+  for (uint8_t i = 0; i < 2; i++) {
+    // murmur3 finalizer over seed, key and stream
+    uint32_t h = _seed ^ (key * 0x9E3779B1UL) ^ ((axis * 2 + i) * 0x85EBCA77UL);
+    h ^= h >> 16;
+    h *= 0x85EBCA6BUL;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35UL;
+    h ^= h >> 16;
+    u[i] = ((h >> 8) + 0.5f) / 16777216.0f;
+  }
+  return sqrt(-2 * log(u[0])) * cos(6.2831853f * u[1]);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Undistorted field in the sensor frame at a given time
+    @param  t Scene time in seconds
+    @param  field Where to store X/Y/Z in gauss
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::fieldAt(double t, float field[3]) {
+  float world[3], origin[3] = {0, 0, 0};
+
+  memcpy(world, _earth, sizeof(world));
+  for (uint8_t d = 0; d < _numDipoles; d++) {
+    lis3mdl_dipole_t dipole = _dipoles[d];
+    float b[3];
+    for (uint8_t a = 0; a < 3; a++)
+      dipole.position[a] += _velocity[d][a] * t;
+    lis3mdl_dipoleField(&dipole, origin, b);
+    for (uint8_t a = 0; a < 3; a++)
+      world[a] += b[a];
+  }
+
+  // Body to world is Rz(yaw) Ry(pitch) Rx(roll); apply its transpose
+  float r = _attitude[0] + _rate[0] * t;
+  float p = _attitude[1] + _rate[1] * t;
+  float y = _attitude[2] + _rate[2] * t;
+  float cr = cos(r), sr = sin(r), cp = cos(p), sp = sin(p);
+  float cy = cos(y), sy = sin(y);
+  float m[3][3] = {{cy * cp, cy * sp * sr - sy * cr, cy * sp * cr + sy * sr},
+                   {sy * cp, sy * sp * sr + cy * cr, sy * sp * cr - cy * sr},
+                   {-sp, cp * sr, cp * cr}};
+  for (uint8_t j = 0; j < 3; j++)
+    field[j] = m[0][j] * world[0] + m[1][j] * world[1] + m[2][j] * world[2];
+}
+
+/**************************************************************************/
+/*!
+    @brief  Build a raw sample the way the sensor would report it
+    @param  t Scene time in seconds
+    @param  key Noise key
+    @param  sample Where to store the sample
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::generate(double t, uint32_t key,
+                                      lis3mdl_sample_t *sample) {
+  float body[3], value[3];
+  uint8_t mode = (_regs[LIS3MDL_REG_CTRL_REG1] >> 5) & 0x03;
+  uint8_t modeZ = (_regs[LIS3MDL_REG_CTRL_REG4] >> 2) & 0x03;
+  float lsb = lis3mdl_rangeToLSBPerGauss(getRange());
+  int32_t fullScale = lsb * ((getRange() + 1) * 4);
+  int16_t *out[3] = {&sample->x, &sample->y, &sample->z};
+
+  if (_regs[LIS3MDL_REG_CTRL_REG3] & 0x20) // LP forces the lowest mode
+    mode = modeZ = LIS3MDL_LOWPOWERMODE;
+
+  fieldAt(t, body);
+  for (uint8_t a = 0; a < 3; a++) {
+    value[a] = _softIron[a][0] * body[0] + _softIron[a][1] * body[1] +
+               _softIron[a][2] * body[2] + _hardIron[a];
+    if (_regs[LIS3MDL_REG_CTRL_REG1] & 0x01) // ST
+      value[a] += lis3mdl_selfTestField[a];
+    if (_noise) {
+      uint16_t sigma = a < 2 ? lis3mdl_noiseXY[mode] : lis3mdl_noiseZ[modeZ];
+      value[a] += sigma * 1e-6f * gaussian(key, a);
+    }
+    int32_t counts = lround(value[a] * lsb);
+    if (counts > fullScale)
+      counts = fullScale;
+    if (counts < -fullScale)
+      counts = -fullScale;
+    *out[a] = counts;
+  }
+  sample->status = 0x0F; // ZYXDA, ZDA, YDA, XDA
+  sample->flags = lis3mdl_sampleFlags(sample);
+  if (_regs[LIS3MDL_REG_CTRL_REG1] & 0x01)
+    sample->flags |= LIS3MDL_FLAG_SELFTEST;
+  sample->timestamp = (uint32_t)(t * 1000);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Ground truth: the field at the sensor, in its own frame, before
+    distortion, noise and quantization
+    @param  index Sample number at the current data rate
+    @param  field Where to store X/Y/Z in gauss
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::getTrueField(uint32_t index, float field[3]) {
+  fieldAt(index * 1000.0 / getRateMilliHz(), field);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Raw sample number index at the current data rate, range and
+    performance mode, as readSample() would return it
+    @param  index Sample number; sample 0 is at time zero
+    @param  sample Where to store the sample
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::getSample(uint32_t index,
+                                       lis3mdl_sample_t *sample) {
+  generate(index * 1000.0 / getRateMilliHz(), index, sample);
+}
+
+/**************************************************************************/
+/*!
+    @brief  The sample after the one last returned by next(), starting at 0
+    @param  sample Where to store the sample
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::next(lis3mdl_sample_t *sample) {
+  getSample(_next++, sample);
+}
+
+/**************************************************************************/
+/*!
+    @brief  Put the emulated registers in their power-on state
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::resetRegisters(void) {
+  memset(_regs, 0, sizeof(_regs));
+  _regs[LIS3MDL_REG_WHO_AM_I] = 0x3D;
+  _regs[LIS3MDL_REG_CTRL_REG1] = 0x10;
+  _regs[LIS3MDL_REG_CTRL_REG3] = 0x03;
+  _regs[LIS3MDL_REG_INT_CFG] = 0xE8;
+  _running = false;
+  _latched = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Start, restart or stop conversions after CTRL_REG1 or CTRL_REG3
+    changed
+    @param  oldRate_mHz Data rate before the write
+    @param  now_us Current time
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::modeChanged(uint32_t oldRate_mHz,
+                                         uint32_t now_us) {
+  uint8_t md = _regs[LIS3MDL_REG_CTRL_REG3] & 0x03;
+  bool restart = !_running || oldRate_mHz != getRateMilliHz();
+
+  if (!_haveOrigin) {
+    _origin_us = now_us;
+    _haveOrigin = true;
+  }
+  if (md == LIS3MDL_SINGLEMODE || (md == LIS3MDL_CONTINUOUSMODE && restart)) {
+    _running = true;
+    _start_us = now_us;
+    _latched = 0;
+  } else if (md != LIS3MDL_CONTINUOUSMODE) {
+    _running = false;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Latch the newest conversion into the output registers
+    @param  now_us Current time
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::update(uint32_t now_us) {
+  if (!_running)
+    return;
+
+  uint32_t rate = getRateMilliHz();
+  uint32_t elapsed = now_us - _start_us, done, at_us;
+  bool single = (_regs[LIS3MDL_REG_CTRL_REG3] & 0x03) == LIS3MDL_SINGLEMODE;
+  if (single) {
+    // One conversion, as long as the averaging takes, then back to idle
+    uint8_t mode = (_regs[LIS3MDL_REG_CTRL_REG1] >> 5) & 0x03;
+    uint8_t modeZ = (_regs[LIS3MDL_REG_CTRL_REG4] >> 2) & 0x03;
+    if (_regs[LIS3MDL_REG_CTRL_REG3] & 0x20) // LP
+      mode = modeZ = LIS3MDL_LOWPOWERMODE;
+    at_us = 1000000000 / lis3mdl_fastRate[mode > modeZ ? mode : modeZ];
+    if (elapsed < at_us)
+      return;
+    done = 1;
+    _regs[LIS3MDL_REG_CTRL_REG3] |= 0x03;
+    _running = false;
+  } else {
+    done = (uint32_t)((uint64_t)elapsed * rate / 1000000000);
+    if (done == _latched)
+      return;
+    at_us = (uint32_t)((uint64_t)done * 1000000000 / rate);
+  }
+  bool skipped = done > _latched + 1;
+  uint8_t unread = _regs[LIS3MDL_REG_STATUS] & 0x07;
+
+  lis3mdl_sample_t sample;
+  double t = ((uint32_t)(_start_us - _origin_us) + (double)at_us) / 1000000.0;
+  generate(t, _key++, &sample);
+  _latched = done;
+
+  // xOR for each axis whose previous value was never read
+  uint8_t status = 0x0F;
+  for (uint8_t a = 0; a < 3; a++)
+    if (skipped || (unread & (1 << a)))
+      status |= 0x10 << a;
+  if (status & 0x70)
+    status |= 0x80; // ZYXOR
+  _regs[LIS3MDL_REG_STATUS] = status;
+  int16_t value[3] = {sample.x, sample.y, sample.z};
+  for (uint8_t a = 0; a < 3; a++) {
+    _regs[LIS3MDL_REG_OUT_X_L + 2 * a] = value[a] & 0xFF;
+    _regs[LIS3MDL_REG_OUT_X_L + 2 * a + 1] = (uint16_t)value[a] >> 8;
+  }
+
+  // Threshold interrupt, on magnitude like the hardware comparator
+  uint8_t cfg = _regs[LIS3MDL_REG_INT_CFG];
+  if (cfg & 0x01) {
+    uint16_t ths = (_regs[LIS3MDL_REG_INT_THS_L] |
+                    (_regs[LIS3MDL_REG_INT_THS_L + 1] << 8)) &
+                   0x7FFF;
+    uint8_t src = 0;
+    for (uint8_t a = 0; a < 3; a++) {
+      if (!(cfg & (0x80 >> a)))
+        continue;
+      if (value[a] > (int32_t)ths)
+        src |= 0x80 >> a; // PTH
+      if (value[a] < -(int32_t)ths)
+        src |= 0x10 >> a; // NTH
+    }
+    if (src)
+      src |= 0x01;  // INT
+    if (cfg & 0x02) // LIR, keep until INT_SRC is read
+      _regs[LIS3MDL_REG_INT_SRC] |= src;
+    else
+      _regs[LIS3MDL_REG_INT_SRC] = src;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Emulated register read with address auto-increment
+    @param  reg First register
+    @param  buffer Where to store the values
+    @param  len Number of registers to read
+    @param  now_us Current time, which decides whether new data is ready
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::readRegisters(uint8_t reg, uint8_t *buffer,
+                                           uint8_t len, uint32_t now_us) {
+  update(now_us);
+  for (uint8_t i = 0; i < len; i++, reg++) {
+    buffer[i] = reg < sizeof(_regs) ? _regs[reg] : 0;
+    // OUT_n_H clears that axis's xDA and xOR, and ZYXDA/ZYXOR go with
+    // the last of them
+    if (reg >= LIS3MDL_REG_OUT_X_L && reg <= LIS3MDL_REG_OUT_X_L + 5 &&
+        (reg - LIS3MDL_REG_OUT_X_L) & 1) {
+      uint8_t a = (reg - LIS3MDL_REG_OUT_X_L) / 2;
+      _regs[LIS3MDL_REG_STATUS] &= ~(0x11 << a);
+      if (!(_regs[LIS3MDL_REG_STATUS] & 0x07))
+        _regs[LIS3MDL_REG_STATUS] = 0;
+    }
+    if (reg == LIS3MDL_REG_INT_SRC)
+      _regs[LIS3MDL_REG_INT_SRC] = 0;
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Emulated register write with address auto-increment. Read-only
+    registers ignore writes.
+    @param  reg First register
+    @param  buffer Values to write
+    @param  len Number of registers to write
+    @param  now_us Current time, when conversions start or restart
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scene::writeRegisters(uint8_t reg, const uint8_t *buffer,
+                                            uint8_t len, uint32_t now_us) {
+  update(now_us);
+  for (uint8_t i = 0; i < len; i++, reg++) {
+    uint32_t oldRate = getRateMilliHz();
+    switch (reg) {
+    case LIS3MDL_REG_CTRL_REG2:
+      if (buffer[i] & 0x04) { // SOFT_RST clears itself
+        resetRegisters();
+        break;
+      }
+      _regs[reg] = buffer[i] & 0x6C;
+      break;
+    case LIS3MDL_REG_CTRL_REG1:
+    case LIS3MDL_REG_CTRL_REG3:
+      _regs[reg] = buffer[i];
+      modeChanged(oldRate, now_us);
+      break;
+    case LIS3MDL_REG_CTRL_REG4:
+    case LIS3MDL_REG_CTRL_REG5:
+    case LIS3MDL_REG_INT_CFG:
+    case LIS3MDL_REG_INT_THS_L:
+    case LIS3MDL_REG_INT_THS_L + 1:
+      _regs[reg] = buffer[i];
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+/**************************************************************************/
+/*!
+    @brief  Level of the emulated INT pin
+    @param  now_us Current time, which decides whether new data is ready
+    @returns True for high. INT is active high when IEA is set, and idles at
+    the inactive level while IEN is clear.
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_Scene::getIntPin(uint32_t now_us) {
+  update(now_us);
+  uint8_t cfg = _regs[LIS3MDL_REG_INT_CFG];
+  bool active = (cfg & 0x01) && (_regs[LIS3MDL_REG_INT_SRC] & 0x01);
+  return active == (bool)(cfg & 0x04);
+}
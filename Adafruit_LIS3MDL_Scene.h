@@ -0,0 +1,94 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Scene.h
+ *
+ * Deterministic synthetic field scenes and a register-level LIS3MDL
+ * emulator built on them
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_SCENE_H
+#define ADAFRUIT_LIS3MDL_SCENE_H
+
+#include <Adafruit_LIS3MDL.h>
+#include <Adafruit_LIS3MDL_Dipole.h>
+
+#ifndef LIS3MDL_SCENE_MAX_DIPOLES
+/** Moving magnets per scene. Define before including to change. */
+#define LIS3MDL_SCENE_MAX_DIPOLES 4
+#endif
+
+/*!
+ * A sensor turning at constant rates in the Earth's field, with hard and
+ * soft iron distortion, moving magnets nearby, and the noise, quantization
+ * and saturation of the configured range and performance mode. Every
+ * sample is a pure function of the seed, the scene and its index, so runs
+ * repeat exactly for a given build and platform and samples can be fetched
+ * in any order. Other builds can differ in the last bits, since float
+ * math routines vary between C libraries and between FPU and soft-float
+ * code.
+ *
+ * The range, data rate and modes live in an emulated register file, which
+ * can also be driven over a mock bus exactly as the driver drives a real
+ * part.
+ */
+class Adafruit_LIS3MDL_Scene {
+public:
+  Adafruit_LIS3MDL_Scene(uint32_t seed = 1);
+
+  void begin(uint32_t seed);
+  void setEarthField(float north, float east, float down);
+  void setAttitude(float roll, float pitch, float yaw);
+  void setRotationRate(float rollRate, float pitchRate, float yawRate);
+  void setHardIron(float x, float y, float z);
+  void setSoftIron(const float matrix[3][3]);
+  int8_t addDipole(const lis3mdl_dipole_t *dipole, const float velocity[3]);
+  void setNoise(bool enable);
+
+  void setRange(lis3mdl_range_t range);
+  void setDataRate(lis3mdl_dataRate_t dataRate);
+  void setPerformanceMode(lis3mdl_performancemode_t mode,
+                          lis3mdl_performancemode_t modeZ);
+  lis3mdl_range_t getRange(void);
+  uint32_t getRateMilliHz(void);
+
+  void getTrueField(uint32_t index, float field[3]);
+  void getSample(uint32_t index, lis3mdl_sample_t *sample);
+  void next(lis3mdl_sample_t *sample);
+
+  void readRegisters(uint8_t reg, uint8_t *buffer, uint8_t len,
+                     uint32_t now_us);
+  void writeRegisters(uint8_t reg, const uint8_t *buffer, uint8_t len,
+                      uint32_t now_us);
+  bool getIntPin(uint32_t now_us);
+
+private:
+  float gaussian(uint32_t key, uint8_t axis);
+  void fieldAt(double t, float field[3]);
+  void generate(double t, uint32_t key, lis3mdl_sample_t *sample);
+  void update(uint32_t now_us);
+  void modeChanged(uint32_t oldRate_mHz, uint32_t now_us);
+  void resetRegisters(void);
+
+  uint32_t _seed;
+  uint32_t _next;
+  float _earth[3];
+  float _attitude[3];
+  float _rate[3];
+  float _hardIron[3];
+  float _softIron[3][3];
+  lis3mdl_dipole_t _dipoles[LIS3MDL_SCENE_MAX_DIPOLES];
+  float _velocity[LIS3MDL_SCENE_MAX_DIPOLES][3];
+  uint8_t _numDipoles;
+  bool _noise;
+
+  // Emulator state
+  uint8_t _regs[0x34];
+  uint32_t _origin_us;
+  uint32_t _start_us;
+  uint32_t _latched;
+  uint32_t _key;
+  bool _haveOrigin;
+  bool _running;
+};
+
+#endif
@@ -0,0 +1,149 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Scheduled.cpp
+ *
+ * Periodic single-shot sampling. The conversion time is taken from the
+ * FAST_ODR period of the slower of the X/Y and Z performance modes, which
+ * is how long one conversion with that many averages takes, plus a 10%
+ * margin. If a read still finds no new data it is retried on the next
+ * poll(), for up to twice the conversion time; after that the conversion
+ * is counted as missed and the next one is triggered on schedule.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_Scheduled.h"
+
+// One conversion in us, indexed by lis3mdl_performancemode_t
+static const uint16_t lis3mdl_conversionTime[4] = {1000, 1786, 3334, 6452};
+
+/**************************************************************************/
+/*!
+    @brief  Instantiates a scheduler for a sensor
+    @param  sensor The sensor, after begin_I2C() or begin_SPI()
+*/
+/**************************************************************************/
+Adafruit_LIS3MDL_Scheduled::Adafruit_LIS3MDL_Scheduled(
+    Adafruit_LIS3MDL *sensor) {
+  _sensor = sensor;
+  _running = false;
+  _converting = false;
+  _sampleTime_us = 0;
+  _missed = 0;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Put the sensor in power-down and start the schedule. The first
+    conversion is triggered by the next poll().
+    @param  interval_ms Time between samples, usually more than the 1600 ms
+    of the slowest continuous rate
+    @param  lowPower Set the LP bit so each conversion uses the fewest
+    averages; false keeps the configured performance modes
+    @returns False if the sensor did not respond
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_Scheduled::begin(uint32_t interval_ms, bool lowPower) {
+  uint8_t ctrl[4];
+
+  if (!_sensor->readRegisters(LIS3MDL_REG_CTRL_REG1, ctrl, 4))
+    return false;
+  _ctrl3 = (ctrl[2] & ~0x23) | (lowPower ? 0x20 : 0);
+  uint8_t idle = _ctrl3 | LIS3MDL_POWERDOWNMODE;
+  if (!_sensor->writeRegisters(LIS3MDL_REG_CTRL_REG3, &idle, 1))
+    return false;
+
+  uint8_t mode = (ctrl[0] >> 5) & 0x03, modeZ = (ctrl[3] >> 2) & 0x03;
+  if (lowPower)
+    mode = modeZ = LIS3MDL_LOWPOWERMODE;
+  uint32_t t = lis3mdl_conversionTime[mode > modeZ ? mode : modeZ];
+  _conversion_us = t + t / 10;
+
+  _interval_ms = interval_ms;
+  _next_ms = millis();
+  _converting = false;
+  _missed = 0;
+  _running = true;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Stop the schedule. The sensor stays in power-down.
+*/
+/**************************************************************************/
+void Adafruit_LIS3MDL_Scheduled::end(void) {
+  _running = false;
+  _converting = false;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Trigger or collect a conversion when one is due
+    @param  sample Where to store a new sample. Its timestamp is the
+    millis() time of the middle of the conversion.
+    @returns True if sample holds a new sample
+*/
+/**************************************************************************/
+bool Adafruit_LIS3MDL_Scheduled::poll(lis3mdl_sample_t *sample) {
+  if (!_running)
+    return false;
+
+  if (!_converting) {
+    if ((int32_t)(millis() - _next_ms) < 0)
+      return false;
+    uint8_t start = _ctrl3 | LIS3MDL_SINGLEMODE;
+    if (!_sensor->writeRegisters(LIS3MDL_REG_CTRL_REG3, &start, 1))
+      return false;
+    _trigger_us = micros();
+    _converting = true;
+
+    // Stay on the original grid unless a whole interval was missed
+    _next_ms += _interval_ms;
+    if ((int32_t)(millis() - _next_ms) >= 0)
+      _next_ms = millis() + _interval_ms;
+    return false;
+  }
+
+  uint32_t elapsed = micros() - _trigger_us;
+  if (elapsed < _conversion_us)
+    return false;
+  if (!_sensor->readSample(sample) || !(sample->status & 0x08)) { // ZYXDA
+    // A failed read or a lost trigger must not stall the schedule
+    if (elapsed >= 2 * _conversion_us) {
+      _converting = false;
+      _missed++;
+    }
+    return false;
+  }
+
+  // The part is back in idle on its own once the conversion is done
+  _converting = false;
+  _sampleTime_us = _trigger_us + _conversion_us / 2;
+  sample->timestamp = millis() - (micros() - _sampleTime_us) / 1000;
+  return true;
+}
+
+/**************************************************************************/
+/*!
+    @brief  How long the caller may sleep before poll() has work to do
+    @returns Milliseconds until the next trigger, 0 while a conversion is
+    pending or a trigger is due
+*/
+/**************************************************************************/
+uint32_t Adafruit_LIS3MDL_Scheduled::msUntilWake(void) {
+  if (!_running)
+    return 0xFFFFFFFF;
+  int32_t wait = _next_ms - millis();
+  return _converting || wait < 0 ? 0 : wait;
+}
+
+/**************************************************************************/
+/*!
+    @brief  Time allowed for one conversion, with margin
+    @returns Microseconds between trigger and read
+*/
+/**************************************************************************/
+uint32_t Adafruit_LIS3MDL_Scheduled::getConversionTime(void) {
+  return _conversion_us;
+}
@@ -0,0 +1,59 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Scheduled.h
+ *
+ * Timer-driven single-shot sampling for intervals longer than the LIS3MDL's
+ * slowest data rate
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_SCHEDULED_H
+#define ADAFRUIT_LIS3MDL_SCHEDULED_H
+
+#include <Adafruit_LIS3MDL.h>
+
+/*!
+ * Triggers one single-shot conversion per interval and leaves the sensor
+ * idle in between. Each wake costs one CTRL_REG3 write to start the
+ * conversion and one STATUS + XYZ burst to collect it, read once the
+ * conversion time has passed, so nothing is polled. Call poll() from the
+ * main loop; it never blocks.
+ */
+class Adafruit_LIS3MDL_Scheduled {
+public:
+  Adafruit_LIS3MDL_Scheduled(Adafruit_LIS3MDL *sensor);
+
+  bool begin(uint32_t interval_ms, bool lowPower = true);
+  void end(void);
+  bool poll(lis3mdl_sample_t *sample);
+
+  uint32_t msUntilWake(void);
+  uint32_t getConversionTime(void);
+
+  /*!
+   *    @brief  When the last sample was measured, the middle of its
+   *    conversion
+   *    @return micros() timestamp
+   */
+  uint32_t sampleTime_us(void) { return _sampleTime_us; }
+
+  /*!
+   *    @brief  Conversions given up on because no new data could be read
+   *    within twice the conversion time
+   *    @return Count since begin()
+   */
+  uint32_t getMissed(void) { return _missed; }
+
+private:
+  Adafruit_LIS3MDL *_sensor;
+  uint32_t _interval_ms;
+  uint32_t _next_ms;
+  uint32_t _trigger_us;
+  uint32_t _conversion_us;
+  uint32_t _sampleTime_us;
+  uint32_t _missed;
+  uint8_t _ctrl3; // CTRL_REG3 with MD cleared
+  bool _running;
+  bool _converting;
+};
+
+#endif
@@ -0,0 +1,38 @@
+// Magnetometer readings without floating point, for boards without an FPU.
+// Builds as is; add -DLIS3MDL_NO_FLOAT to the build flags to also drop the
+// float parts of the library. extras/footprint.sh compares the two builds.
+
+#include <Wire.h>
+#include <Adafruit_LIS3MDL.h>
+
+Adafruit_LIS3MDL lis3mdl;
+
+void setup(void) {
+  Serial.begin(115200);
+  while (!Serial) delay(10);     // will pause Zero, Leonardo, etc until serial console opens
+
+  if (! lis3mdl.begin_I2C()) {
+    Serial.println("Failed to find LIS3MDL chip");
+    while (1) { delay(10); }
+  }
+
+  lis3mdl.setRange(LIS3MDL_RANGE_4_GAUSS);
+  lis3mdl.setDataRate(LIS3MDL_DATARATE_155_HZ);
+  Serial.print("Data rate: ");
+  Serial.print(lis3mdl_dataRateToMilliHz(lis3mdl.getDataRate()));
+  Serial.println(" mHz");
+}
+
+void loop() {
+  int32_t x, y, z;
+
+  // Field in nanotesla, 1 gauss = 100000 nT
+  if (lis3mdl.readMagneticField(x, y, z)) {
+    Serial.print("X: "); Serial.print(x);
+    Serial.print(" \tY: "); Serial.print(y);
+    Serial.print(" \tZ: "); Serial.print(z);
+    Serial.println(" nT");
+  }
+
+  delay(100);
+}
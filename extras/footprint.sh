@@ -0,0 +1,20 @@
+#!/bin/sh
+# Flash and RAM used by the integer example with and without
+# LIS3MDL_NO_FLOAT, as reported by arduino-cli. Pass the boards to measure;
+# the library and its dependencies must be installed.
+#
+#   extras/footprint.sh arduino:avr:uno adafruit:samd:adafruit_qtpy_m0
+
+set -e
+
+SKETCH="$(dirname "$0")/../examples/lis3mdl_integer"
+[ $# -gt 0 ] || set -- arduino:avr:uno
+
+for fqbn in "$@"; do
+  for flags in "" "-DLIS3MDL_NO_FLOAT"; do
+    printf '%s %s\n' "$fqbn" "${flags:-(default)}"
+    arduino-cli compile --fqbn "$fqbn" \
+      --build-property "compiler.cpp.extra_flags=$flags" "$SKETCH" |
+      grep -E 'Sketch uses|Global variables use'
+  done
+done
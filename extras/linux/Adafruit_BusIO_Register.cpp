@@ -0,0 +1,193 @@
+/*!
+ * @file     Adafruit_BusIO_Register.cpp
+ *
+ * Register access for the Linux port. A read is always one combined
+ * address-write/data-read transaction, so multi-byte bursts such as
+ * STATUS + XYZ cost a single ioctl.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_BusIO_Register.h"
+
+/*!
+ *    @brief  Create a register we can talk to over I2C or SPI
+ *    @param  i2cdevice The I2C device to use, or NULL
+ *    @param  spidevice The SPI device to use, or NULL
+ *    @param  type How the address byte is marked for SPI
+ *    @param  reg_addr Register address
+ *    @param  width Width of the register in bytes
+ *    @param  byteorder LSBFIRST or MSBFIRST for multi-byte registers
+ *    @param  address_width Only single byte addresses are supported here
+ */
+Adafruit_BusIO_Register::Adafruit_BusIO_Register(
+    Adafruit_I2CDevice *i2cdevice, Adafruit_SPIDevice *spidevice,
+    Adafruit_BusIO_SPIRegType type, uint16_t reg_addr, uint8_t width,
+    uint8_t byteorder, uint8_t address_width)
+    : _i2cdevice(i2cdevice), _spidevice(spidevice), _spiregtype(type),
+      _address(reg_addr), _width(width), _byteorder(byteorder) {
+  (void)address_width;
+}
+
+/*!
+ *    @brief  The address byte as it goes on the wire
+ *    @param  reading True for a read, false for a write
+ *    @return Address with any SPI read/increment bits applied
+ */
+uint8_t Adafruit_BusIO_Register::addressByte(bool reading) {
+  uint8_t addr = _address & 0xFF;
+  if (!_spidevice)
+    return addr;
+
+  switch (_spiregtype) {
+  case ADDRBIT8_HIGH_TOREAD:
+    addr = reading ? (addr | 0x80) : (addr & ~0x80);
+    break;
+  case AD8_HIGH_TOREAD_AD7_HIGH_TOINC:
+    addr |= 0x40;
+    if (reading)
+      addr |= 0x80;
+    break;
+  case ADDRBIT8_HIGH_TOWRITE:
+    if (!reading)
+      addr |= 0x80;
+    break;
+  case ADDRESSED_OPCODE_BIT0_LOW_TO_WRITE:
+    addr = reading ? (addr | 0x01) : (addr & ~0x01);
+    break;
+  }
+  return addr;
+}
+
+/*!
+ *    @brief  Read a buffer of data from the register location
+ *    @param  buffer Where to store the data
+ *    @param  len Number of bytes to read
+ *    @return True on success
+ */
+bool Adafruit_BusIO_Register::read(uint8_t *buffer, uint8_t len) {
+  uint8_t addr = addressByte(true);
+  if (_i2cdevice)
+    return _i2cdevice->write_then_read(&addr, 1, buffer, len);
+  if (_spidevice)
+    return _spidevice->write_then_read(&addr, 1, buffer, len);
+  return false;
+}
+
+/*!
+ *    @brief  Read one byte from the register
+ *    @param  value Where to store the byte
+ *    @return True on success
+ */
+bool Adafruit_BusIO_Register::read(uint8_t *value) { return read(value, 1); }
+
+/*!
+ *    @brief  Read two bytes from the register, honouring the byte order
+ *    @param  value Where to store the result
+ *    @return True on success
+ */
+bool Adafruit_BusIO_Register::read(uint16_t *value) {
+  uint8_t buffer[2];
+  if (!read(buffer, 2))
+    return false;
+  if (_byteorder == LSBFIRST)
+    *value = buffer[0] | (buffer[1] << 8);
+  else
+    *value = buffer[1] | (buffer[0] << 8);
+  return true;
+}
+
+/*!
+ *    @brief  Read the whole register as an integer
+ *    @return The register value, or 0xFFFFFFFF on failure
+ */
+uint32_t Adafruit_BusIO_Register::read(void) {
+  uint8_t buffer[4];
+  if (_width > 4 || !read(buffer, _width))
+    return 0xFFFFFFFF;
+
+  uint32_t value = 0;
+  for (int i = 0; i < _width; i++) {
+    value <<= 8;
+    value |= buffer[_byteorder == LSBFIRST ? _width - 1 - i : i];
+  }
+  return value;
+}
+
+/*!
+ *    @brief  Write a buffer of data to the register location
+ *    @param  buffer Data to write
+ *    @param  len Number of bytes to write
+ *    @return True on success
+ */
+bool Adafruit_BusIO_Register::write(uint8_t *buffer, uint8_t len) {
+  uint8_t addr = addressByte(false);
+  if (_i2cdevice)
+    return _i2cdevice->write(buffer, len, true, &addr, 1);
+  if (_spidevice)
+    return _spidevice->write(buffer, len, &addr, 1);
+  return false;
+}
+
+/*!
+ *    @brief  Write an integer to the register, honouring the byte order
+ *    @param  value The value to write
+ *    @param  numbytes Number of bytes to write, 0 for the register width
+ *    @return True on success
+ */
+bool Adafruit_BusIO_Register::write(uint32_t value, uint8_t numbytes) {
+  uint8_t buffer[4];
+  if (numbytes == 0)
+    numbytes = _width;
+  if (numbytes > 4)
+    return false;
+
+  for (int i = 0; i < numbytes; i++) {
+    uint8_t b = (value >> (8 * i)) & 0xFF;
+    if (_byteorder == LSBFIRST)
+      buffer[i] = b;
+    else
+      buffer[numbytes - 1 - i] = b;
+  }
+  return write(buffer, numbytes);
+}
+
+/*!
+ *    @brief  The width of the register
+ *    @return Width in bytes
+ */
+uint8_t Adafruit_BusIO_Register::width(void) { return _width; }
+
+/*!
+ *    @brief  Create a bit field within a register
+ *    @param  reg The register holding the field
+ *    @param  bits Width of the field
+ *    @param  shift Position of the lowest bit
+ */
+Adafruit_BusIO_RegisterBits::Adafruit_BusIO_RegisterBits(
+    Adafruit_BusIO_Register *reg, uint8_t bits, uint8_t shift)
+    : _register(reg), _bits(bits), _shift(shift) {}
+
+/*!
+ *    @brief  Read the bit field
+ *    @return The field value, shifted down
+ */
+uint32_t Adafruit_BusIO_RegisterBits::read(void) {
+  uint32_t value = _register->read();
+  return (value >> _shift) & ((1UL << _bits) - 1);
+}
+
+/*!
+ *    @brief  Read-modify-write the bit field
+ *    @param  data The new field value
+ *    @return True on success
+ */
+bool Adafruit_BusIO_RegisterBits::write(uint32_t data) {
+  uint32_t value = _register->read();
+  uint32_t mask = (1UL << _bits) - 1;
+
+  value &= ~(mask << _shift);
+  value |= (data & mask) << _shift;
+  return _register->write(value, _register->width());
+}
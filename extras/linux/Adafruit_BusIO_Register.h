@@ -0,0 +1,64 @@
+/*!
+ * @file     Adafruit_BusIO_Register.h
+ *
+ * Linux implementation of the Adafruit BusIO register helpers, matching the
+ * subset of the Arduino library's API used by the LIS3MDL driver.
+ *
+ */
+
+#ifndef LIS3MDL_LINUX_BUSIO_REGISTER_H
+#define LIS3MDL_LINUX_BUSIO_REGISTER_H
+
+#include "Adafruit_I2CDevice.h"
+#include "Adafruit_SPIDevice.h"
+
+/** How the register address byte is marked for SPI reads and writes */
+typedef enum _Adafruit_BusIO_SPIRegType {
+  ADDRBIT8_HIGH_TOREAD = 0,               ///< Bit 7 set for reads
+  AD8_HIGH_TOREAD_AD7_HIGH_TOINC = 1,     ///< Bit 7 reads, bit 6 increments
+  ADDRBIT8_HIGH_TOWRITE = 2,              ///< Bit 7 set for writes
+  ADDRESSED_OPCODE_BIT0_LOW_TO_WRITE = 3, ///< Bit 0 clear for writes
+} Adafruit_BusIO_SPIRegType;
+
+/** A register of one or more bytes on an I2C or SPI device */
+class Adafruit_BusIO_Register {
+public:
+  Adafruit_BusIO_Register(Adafruit_I2CDevice *i2cdevice,
+                          Adafruit_SPIDevice *spidevice,
+                          Adafruit_BusIO_SPIRegType type, uint16_t reg_addr,
+                          uint8_t width = 1, uint8_t byteorder = LSBFIRST,
+                          uint8_t address_width = 1);
+
+  bool read(uint8_t *buffer, uint8_t len);
+  bool read(uint8_t *value);
+  bool read(uint16_t *value);
+  uint32_t read(void);
+  bool write(uint8_t *buffer, uint8_t len);
+  bool write(uint32_t value, uint8_t numbytes = 0);
+
+  uint8_t width(void);
+
+private:
+  uint8_t addressByte(bool reading);
+
+  Adafruit_I2CDevice *_i2cdevice;
+  Adafruit_SPIDevice *_spidevice;
+  Adafruit_BusIO_SPIRegType _spiregtype;
+  uint16_t _address;
+  uint8_t _width, _byteorder;
+};
+
+/** A bit field within a register */
+class Adafruit_BusIO_RegisterBits {
+public:
+  Adafruit_BusIO_RegisterBits(Adafruit_BusIO_Register *reg, uint8_t bits,
+                              uint8_t shift);
+  bool write(uint32_t value);
+  uint32_t read(void);
+
+private:
+  Adafruit_BusIO_Register *_register;
+  uint8_t _bits, _shift;
+};
+
+#endif
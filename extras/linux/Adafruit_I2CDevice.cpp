@@ -0,0 +1,138 @@
+/*!
+ * @file     Adafruit_I2CDevice.cpp
+ *
+ * i2c-dev backed I2C device for the Linux port
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_I2CDevice.h"
+
+#include <linux/i2c.h>
+
+/*!
+ *    @brief  Create an I2C device at a given address
+ *    @param  addr The 7-bit I2C address for the device
+ *    @param  theWire The bus the device is on
+ */
+Adafruit_I2CDevice::Adafruit_I2CDevice(uint8_t addr, TwoWire *theWire)
+    : _addr(addr), _wire(theWire) {}
+
+/*!
+ *    @brief  Open the bus and optionally check the device answers
+ *    @param  addr_detect Whether to probe the address
+ *    @return True if the bus opened and, when probing, the device ACKed
+ */
+bool Adafruit_I2CDevice::begin(bool addr_detect) {
+  if (!_wire->begin())
+    return false;
+  _begun = true;
+  if (addr_detect)
+    return detected();
+  return true;
+}
+
+/*!
+ *    @brief  Release the device. The bus stays open for other devices.
+ */
+void Adafruit_I2CDevice::end(void) { _begun = false; }
+
+/*!
+ *    @brief  Probe the address with a one byte read, which every i2c-dev
+ *            adapter supports (unlike zero length writes)
+ *    @return True if the device ACKed
+ */
+bool Adafruit_I2CDevice::detected(void) {
+  uint8_t dummy;
+  return read(&dummy, 1);
+}
+
+/*!
+ *    @brief  The 7-bit address of this device
+ *    @return The I2C address
+ */
+uint8_t Adafruit_I2CDevice::address(void) { return _addr; }
+
+/*!
+ *    @brief  Read from the device in one transaction
+ *    @param  buffer Where to store the data
+ *    @param  len Number of bytes to read
+ *    @param  stop Ignored, the kernel always ends a transaction with a stop
+ *    @return True on success
+ */
+bool Adafruit_I2CDevice::read(uint8_t *buffer, size_t len, bool stop) {
+  (void)stop;
+  struct i2c_msg msg;
+  msg.addr = _addr;
+  msg.flags = I2C_M_RD;
+  msg.len = len;
+  msg.buf = buffer;
+  return _wire->transfer(&msg, 1);
+}
+
+/*!
+ *    @brief  Write to the device in one transaction
+ *    @param  buffer Data to write
+ *    @param  len Number of bytes to write
+ *    @param  stop Ignored, the kernel always ends a transaction with a stop
+ *    @param  prefix_buffer Optional bytes sent first, usually the register
+ *    @param  prefix_len Number of prefix bytes
+ *    @return True on success
+ */
+bool Adafruit_I2CDevice::write(const uint8_t *buffer, size_t len, bool stop,
+                               const uint8_t *prefix_buffer,
+                               size_t prefix_len) {
+  (void)stop;
+  uint8_t data[LIS3MDL_LINUX_I2C_MAX_WRITE];
+
+  // The prefix and payload must go out in one message, without a restart
+  if (len + prefix_len > sizeof(data))
+    return false;
+  if (prefix_len)
+    memcpy(data, prefix_buffer, prefix_len);
+  if (len)
+    memcpy(data + prefix_len, buffer, len);
+
+  struct i2c_msg msg;
+  msg.addr = _addr;
+  msg.flags = 0;
+  msg.len = len + prefix_len;
+  msg.buf = data;
+  return _wire->transfer(&msg, 1);
+}
+
+/*!
+ *    @brief  Write then read with a repeated start, in a single ioctl
+ *    @param  write_buffer Data to write, usually the register address
+ *    @param  write_len Number of bytes to write
+ *    @param  read_buffer Where to store the data read back
+ *    @param  read_len Number of bytes to read
+ *    @param  stop Ignored, there is always a repeated start in between
+ *    @return True on success
+ */
+bool Adafruit_I2CDevice::write_then_read(const uint8_t *write_buffer,
+                                         size_t write_len, uint8_t *read_buffer,
+                                         size_t read_len, bool stop) {
+  (void)stop;
+  struct i2c_msg msgs[2];
+  msgs[0].addr = _addr;
+  msgs[0].flags = 0;
+  msgs[0].len = write_len;
+  msgs[0].buf = (uint8_t *)write_buffer;
+  msgs[1].addr = _addr;
+  msgs[1].flags = I2C_M_RD;
+  msgs[1].len = read_len;
+  msgs[1].buf = read_buffer;
+  return _wire->transfer(msgs, 2);
+}
+
+/*!
+ *    @brief  The bus clock is set by the kernel on Linux
+ *    @param  desiredclk Ignored
+ *    @return Always false, the speed cannot be changed from userspace
+ */
+bool Adafruit_I2CDevice::setSpeed(uint32_t desiredclk) {
+  (void)desiredclk;
+  return false;
+}
@@ -0,0 +1,52 @@
+/*!
+ * @file     Adafruit_I2CDevice.h
+ *
+ * Linux implementation of the Adafruit BusIO I2C device interface, on top of
+ * i2c-dev. Only the calls the LIS3MDL driver makes are provided.
+ *
+ */
+
+#ifndef LIS3MDL_LINUX_I2CDEVICE_H
+#define LIS3MDL_LINUX_I2CDEVICE_H
+
+#include "Wire.h"
+
+/** Largest single I2C write, including the register address prefix */
+#define LIS3MDL_LINUX_I2C_MAX_WRITE 64
+
+/** An I2C slave on a Linux i2c-dev bus */
+class Adafruit_I2CDevice {
+public:
+  Adafruit_I2CDevice(uint8_t addr, TwoWire *theWire = &Wire);
+  uint8_t address(void);
+  bool begin(bool addr_detect = true);
+  void end(void);
+  bool detected(void);
+
+  bool read(uint8_t *buffer, size_t len, bool stop = true);
+  bool write(const uint8_t *buffer, size_t len, bool stop = true,
+             const uint8_t *prefix_buffer = NULL, size_t prefix_len = 0);
+  bool write_then_read(const uint8_t *write_buffer, size_t write_len,
+                       uint8_t *read_buffer, size_t read_len,
+                       bool stop = false);
+  bool setSpeed(uint32_t desiredclk);
+
+  /*!
+   *    @brief  How many bytes we can write in one transaction
+   *    @return The maximum buffer size
+   */
+  size_t maxBufferSize() { return LIS3MDL_LINUX_I2C_MAX_WRITE; }
+
+  /*!
+   *    @brief  The bus this device sits on
+   *    @return Pointer to the TwoWire bus
+   */
+  TwoWire *bus(void) { return _wire; }
+
+private:
+  uint8_t _addr;
+  TwoWire *_wire;
+  bool _begun = false;
+};
+
+#endif
@@ -0,0 +1,124 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Acquisition.cpp
+ *
+ * Background acquisition thread. The thread polls STATUS + XYZ in one burst
+ * on a fixed schedule and, whenever ZYXDA is set, writes a new snapshot
+ * under the sequence lock. Readers copy the snapshot and retry only if they
+ * raced a write, so the acquisition thread never waits on them.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_Acquisition.h"
+
+#include <time.h>
+
+/*!
+ *    @brief  Set up acquisition for a sensor that has already been begun
+ *    @param  sensor The sensor the thread will own while it runs
+ */
+Adafruit_LIS3MDL_Acquisition::Adafruit_LIS3MDL_Acquisition(
+    Adafruit_LIS3MDL *sensor)
+    : _sensor(sensor) {
+  memset(&_latest, 0, sizeof(_latest));
+}
+
+Adafruit_LIS3MDL_Acquisition::~Adafruit_LIS3MDL_Acquisition(void) { stop(); }
+
+/*!
+ *    @brief  Start the acquisition thread. Until stop() returns, the thread
+ *            is the only one allowed to touch the sensor, and the sensor's
+ *            own x/y/z members must not be read from other threads; use
+ *            latest() instead. Change range or data rate while stopped.
+ *    @param  pollPeriod_us How often to poll the sensor, or 0 to poll at
+ *            twice the configured data rate
+ *    @return True if the thread is running
+ */
+bool Adafruit_LIS3MDL_Acquisition::start(uint32_t pollPeriod_us) {
+  if (_running)
+    return true;
+
+  if (pollPeriod_us == 0) {
+    uint32_t rate_mHz = lis3mdl_dataRateToMilliHz(_sensor->getDataRate());
+    pollPeriod_us = rate_mHz ? 500000000UL / rate_mHz : 1000;
+  }
+  _pollPeriod_us = pollPeriod_us ? pollPeriod_us : 1;
+  _lsbPerGauss = lis3mdl_rangeToLSBPerGauss(_sensor->getRange());
+  __atomic_store_n(&_errors, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&_stop, false, __ATOMIC_RELAXED);
+
+  if (pthread_create(&_thread, NULL, threadEntry, this) != 0)
+    return false;
+  _running = true;
+  return true;
+}
+
+/*!
+ *    @brief  Stop the acquisition thread and wait for it to exit. The last
+ *            snapshot stays readable.
+ */
+void Adafruit_LIS3MDL_Acquisition::stop(void) {
+  if (!_running)
+    return;
+  __atomic_store_n(&_stop, true, __ATOMIC_RELAXED);
+  pthread_join(_thread, NULL);
+  _running = false;
+}
+
+/*!
+ *    @brief  Copy out the newest snapshot. Never blocks the acquisition
+ *            thread and is safe to call from any number of threads.
+ *    @param  snapshot Where to store the snapshot
+ *    @return False if no sample has been published yet
+ */
+bool Adafruit_LIS3MDL_Acquisition::latest(lis3mdl_snapshot_t *snapshot) const {
+  _latest.read(snapshot);
+  return snapshot->sequence != 0;
+}
+
+void *Adafruit_LIS3MDL_Acquisition::threadEntry(void *arg) {
+  ((Adafruit_LIS3MDL_Acquisition *)arg)->run();
+  return NULL;
+}
+
+void Adafruit_LIS3MDL_Acquisition::run(void) {
+  lis3mdl_snapshot_t snapshot;
+  lis3mdl_sample_t sample;
+  struct timespec next, now;
+  float scale = _lsbPerGauss;
+
+  _latest.read(&snapshot);
+  clock_gettime(CLOCK_MONOTONIC, &next);
+
+  while (!__atomic_load_n(&_stop, __ATOMIC_RELAXED)) {
+    if (!_sensor->readSample(&sample)) {
+      __atomic_fetch_add(&_errors, 1, __ATOMIC_RELAXED);
+    } else if (sample.status & 0x08) { // ZYXDA
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      snapshot.x = sample.x;
+      snapshot.y = sample.y;
+      snapshot.z = sample.z;
+      snapshot.x_gauss = (float)sample.x / scale;
+      snapshot.y_gauss = (float)sample.y / scale;
+      snapshot.z_gauss = (float)sample.z / scale;
+      snapshot.timestamp_us =
+          (uint64_t)now.tv_sec * 1000000ULL + now.tv_nsec / 1000;
+      snapshot.sequence++;
+      _latest.write(snapshot);
+    }
+
+    // Absolute deadlines, so time spent on the bus does not add drift
+    next.tv_nsec += (long)(_pollPeriod_us % 1000000) * 1000;
+    next.tv_sec += _pollPeriod_us / 1000000;
+    if (next.tv_nsec >= 1000000000L) {
+      next.tv_nsec -= 1000000000L;
+      next.tv_sec++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec > next.tv_sec ||
+        (now.tv_sec == next.tv_sec && now.tv_nsec > next.tv_nsec))
+      next = now; // overran, do not burst to catch up
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+}
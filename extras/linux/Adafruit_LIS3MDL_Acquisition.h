@@ -0,0 +1,68 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Acquisition.h
+ *
+ * Background acquisition thread for LIS3MDL on multi-threaded Linux hosts.
+ * The thread owns the sensor and publishes the newest sample as a snapshot
+ * guarded by a sequence lock, so any number of threads can read it without
+ * ever blocking the acquisition thread.
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_ACQUISITION_H
+#define ADAFRUIT_LIS3MDL_ACQUISITION_H
+
+#include "Adafruit_LIS3MDL_Seqlock.h"
+#include <Adafruit_LIS3MDL.h>
+#include <pthread.h>
+
+/** The newest sample, as published by the acquisition thread */
+typedef struct {
+  int16_t x;             ///< X axis in raw units
+  int16_t y;             ///< Y axis in raw units
+  int16_t z;             ///< Z axis in raw units
+  float x_gauss;         ///< X axis in gauss
+  float y_gauss;         ///< Y axis in gauss
+  float z_gauss;         ///< Z axis in gauss
+  uint64_t timestamp_us; ///< CLOCK_MONOTONIC time of the read, in us
+  uint32_t sequence;     ///< Number of samples published, from 1
+} lis3mdl_snapshot_t;
+
+/** Reads the sensor on its own thread and shares the latest sample */
+class Adafruit_LIS3MDL_Acquisition {
+public:
+  Adafruit_LIS3MDL_Acquisition(Adafruit_LIS3MDL *sensor);
+  ~Adafruit_LIS3MDL_Acquisition(void);
+
+  bool start(uint32_t pollPeriod_us = 0);
+  void stop(void);
+  bool latest(lis3mdl_snapshot_t *snapshot) const;
+
+  /*!
+   *    @brief  Number of samples published so far, without copying one out
+   *    @return Same as the sequence of the newest snapshot
+   */
+  uint32_t sequence(void) const { return _latest.writes(); }
+
+  /*!
+   *    @brief  Bus reads that failed since start()
+   *    @return Error count
+   */
+  uint32_t errors(void) const {
+    return __atomic_load_n(&_errors, __ATOMIC_RELAXED);
+  }
+
+private:
+  static void *threadEntry(void *arg);
+  void run(void);
+
+  Adafruit_LIS3MDL *_sensor;
+  Adafruit_LIS3MDL_Seqlock<lis3mdl_snapshot_t> _latest;
+  pthread_t _thread;
+  bool _running = false;
+  bool _stop = false;
+  uint32_t _errors = 0;
+  uint32_t _pollPeriod_us = 0;
+  uint16_t _lsbPerGauss = 1;
+};
+
+#endif
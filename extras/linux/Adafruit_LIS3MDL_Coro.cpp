@@ -0,0 +1,168 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Coro.cpp
+ *
+ * Scheduler and sensor operations behind Adafruit_LIS3MDL_Coro.h. Each poll
+ * is one blocking STATUS + XYZ burst; between polls the scheduler services
+ * every other waiting coroutine, and sleeps only when nothing at all is due.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#if __cplusplus >= 202002L
+
+#include "Adafruit_LIS3MDL_Coro.h"
+
+#include <time.h>
+
+/*!
+ *    @brief  Tell the scheduler a task has finished, then free its frame
+ *    @return Never suspend
+ */
+std::suspend_never
+Adafruit_LIS3MDL_Task::promise_type::final_suspend() noexcept {
+  if (scheduler)
+    scheduler->_live--;
+  return {};
+}
+
+/*!
+ *    @brief  Destroy the frames of tasks that have not finished. Each one is
+ *            suspended in exactly one place: the ready queue if it never
+ *            ran, otherwise the timer entry of the waiter it awaits.
+ */
+Adafruit_LIS3MDL_Scheduler::~Adafruit_LIS3MDL_Scheduler(void) {
+  std::vector<std::coroutine_handle<>> pending(_ready.begin(), _ready.end());
+  for (; !_timers.empty(); _timers.pop())
+    pending.push_back(_timers.top().waiter->handle);
+  // Waiters live in the frames, so collect every handle before destroying
+  for (std::coroutine_handle<> h : pending)
+    h.destroy();
+}
+
+/*!
+ *    @brief  Start a task on the next runOnce()
+ *    @param  task The task, owned by the scheduler from now on
+ */
+void Adafruit_LIS3MDL_Scheduler::spawn(Adafruit_LIS3MDL_Task task) {
+  task._handle.promise().scheduler = this;
+  _ready.push_back(task._handle);
+  task._handle = nullptr;
+  _live++;
+}
+
+/*!
+ *    @brief  Queue a waiter to be polled
+ *    @param  waiter The waiter, which must stay alive until it is resumed
+ *    @param  when_us Deadline on the now_us() clock
+ */
+void Adafruit_LIS3MDL_Scheduler::schedule(Adafruit_LIS3MDL_Waiter *waiter,
+                                          uint64_t when_us) {
+  Entry entry = {when_us, _order++, waiter};
+  _timers.push(entry);
+}
+
+/*!
+ *    @brief  Monotonic time base used for deadlines
+ *    @return CLOCK_MONOTONIC in microseconds
+ */
+uint64_t Adafruit_LIS3MDL_Scheduler::now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+/*!
+ *    @brief  Run newly spawned tasks, then wait for the earliest deadline
+ *            and poll everything that is due
+ *    @return False once no tasks are left
+ */
+bool Adafruit_LIS3MDL_Scheduler::runOnce(void) {
+  while (!_ready.empty()) {
+    std::coroutine_handle<> h = _ready.front();
+    _ready.pop_front();
+    h.resume();
+  }
+  if (_timers.empty())
+    return _live != 0;
+
+  uint64_t when = _timers.top().when_us;
+  if (when > now_us()) {
+    struct timespec ts;
+    ts.tv_sec = when / 1000000;
+    ts.tv_nsec = (long)(when % 1000000) * 1000;
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+  }
+
+  uint64_t now = now_us();
+  while (!_timers.empty() && _timers.top().when_us <= now) {
+    Entry entry = _timers.top();
+    _timers.pop();
+    if (entry.waiter->poll()) {
+      entry.waiter->handle.resume();
+    } else {
+      // Keep the cadence, but never queue a deadline that is already past
+      uint64_t next = entry.when_us + entry.waiter->period_us;
+      schedule(entry.waiter, next > now ? next : now + 1);
+    }
+  }
+  return _live != 0;
+}
+
+/*!
+ *    @brief  Run until every spawned task has finished
+ */
+void Adafruit_LIS3MDL_Scheduler::run(void) {
+  while (runOnce()) {
+  }
+}
+
+/*!
+ *    @brief  Wrap a sensor that has already been begun
+ *    @param  scheduler The scheduler its operations wait on
+ *    @param  sensor The sensor; only coroutines on this scheduler may use it
+ *    @param  pollPeriod_us Time between STATUS polls while waiting, or 0 for
+ *            half the configured data rate period
+ */
+Adafruit_LIS3MDL_Async::Adafruit_LIS3MDL_Async(
+    Adafruit_LIS3MDL_Scheduler *scheduler, Adafruit_LIS3MDL *sensor,
+    uint32_t pollPeriod_us)
+    : _scheduler(scheduler), _sensor(sensor) {
+  if (pollPeriod_us == 0) {
+    uint32_t rate_mHz = lis3mdl_dataRateToMilliHz(sensor->getDataRate());
+    pollPeriod_us = rate_mHz ? 500000000UL / rate_mHz : 1000;
+  }
+  _pollPeriod_us = pollPeriod_us ? pollPeriod_us : 1;
+}
+
+/*!
+ *    @brief  Read STATUS + XYZ once
+ *    @param  sample Where to store the reading
+ *    @return True if ZYXDA was set, so the sample is new
+ */
+bool Adafruit_LIS3MDL_Async::Operation::fetch(lis3mdl_sample_t *sample) {
+  if (!_async->_sensor->readSample(sample)) {
+    _async->_errors++;
+    return false;
+  }
+  return sample->status & 0x08; // ZYXDA
+}
+
+/*!
+ *    @brief  Read STATUS + XYZ once and compare the selected axes
+ *    @return True if a new sample is beyond the threshold
+ */
+bool Adafruit_LIS3MDL_Async::Threshold::poll(void) {
+  if (!fetch(&_sample))
+    return false;
+
+  int16_t axis[3] = {_sample.x, _sample.y, _sample.z};
+  for (uint8_t i = 0; i < 3; i++) {
+    int32_t value = axis[i];
+    if ((_axes & (1 << i)) && (value < 0 ? -value : value) > _threshold)
+      return true;
+  }
+  return false;
+}
+
+#endif
@@ -0,0 +1,346 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Coro.h
+ *
+ * Cooperative polling of many LIS3MDL sensors from one thread, written as
+ * C++20 coroutines. The transport stays blocking: each poll is one short
+ * STATUS + XYZ read. A coroutine that waits for data is suspended between
+ * polls, so no caller sleeps waiting for a sample while others are due.
+ * Requires -std=c++20; the matching .cpp compiles to nothing otherwise.
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_CORO_H
+#define ADAFRUIT_LIS3MDL_CORO_H
+
+#if __cplusplus < 202002L
+#error "Adafruit_LIS3MDL_Coro.h needs C++20 (-std=c++20)"
+#endif
+
+#include <Adafruit_LIS3MDL.h>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <queue>
+#include <span>
+#include <vector>
+
+class Adafruit_LIS3MDL_Scheduler;
+
+/** A detached coroutine, handed to Adafruit_LIS3MDL_Scheduler::spawn() */
+class Adafruit_LIS3MDL_Task {
+public:
+  /** Coroutine promise, see the C++20 coroutine rules */
+  struct promise_type {
+    Adafruit_LIS3MDL_Scheduler *scheduler = nullptr; ///< Set by spawn()
+
+    /*!
+     *    @brief  Wrap the new coroutine
+     *    @return A task owning the coroutine
+     */
+    Adafruit_LIS3MDL_Task get_return_object() {
+      return Adafruit_LIS3MDL_Task(
+          std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+    /*!
+     *    @brief  Tasks start when spawned, not when called
+     *    @return Always suspend
+     */
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    std::suspend_never final_suspend() noexcept;
+    /*!
+     *    @brief  Tasks return nothing
+     */
+    void return_void() {}
+    /*!
+     *    @brief  There is nobody to rethrow to
+     */
+    void unhandled_exception() { std::terminate(); }
+  };
+
+  /*!
+   *    @brief  Take over a coroutine
+   *    @param  handle The coroutine to own
+   */
+  explicit Adafruit_LIS3MDL_Task(std::coroutine_handle<promise_type> handle)
+      : _handle(handle) {}
+  /*!
+   *    @brief  Move a task
+   *    @param  other The task to take the coroutine from
+   */
+  Adafruit_LIS3MDL_Task(Adafruit_LIS3MDL_Task &&other)
+      : _handle(other._handle) {
+    other._handle = nullptr;
+  }
+  Adafruit_LIS3MDL_Task(const Adafruit_LIS3MDL_Task &) = delete;
+  /*!
+   *    @brief  Destroy the coroutine if it was never spawned
+   */
+  ~Adafruit_LIS3MDL_Task(void) {
+    if (_handle)
+      _handle.destroy();
+  }
+
+private:
+  friend class Adafruit_LIS3MDL_Scheduler;
+  std::coroutine_handle<promise_type> _handle;
+};
+
+/*!
+ * Something a coroutine is waiting for. The scheduler calls poll() at each
+ * deadline and resumes the coroutine once it returns true.
+ */
+class Adafruit_LIS3MDL_Waiter {
+public:
+  virtual ~Adafruit_LIS3MDL_Waiter(void) {}
+  /*!
+   *    @brief  Check whether the wait is over
+   *    @return True to resume the coroutine
+   */
+  virtual bool poll(void) = 0;
+
+  std::coroutine_handle<> handle; ///< The suspended coroutine
+  uint32_t period_us = 0;         ///< Time between polls
+};
+
+/** Single-threaded event loop that runs tasks and polls their waits */
+class Adafruit_LIS3MDL_Scheduler {
+public:
+  ~Adafruit_LIS3MDL_Scheduler(void);
+
+  /** Suspends the awaiting coroutine for a fixed time */
+  class Sleep : public Adafruit_LIS3MDL_Waiter {
+  public:
+    /*!
+     *    @brief  Set up a sleep
+     *    @param  scheduler The scheduler to wait on
+     *    @param  us Time to sleep
+     */
+    Sleep(Adafruit_LIS3MDL_Scheduler *scheduler, uint32_t us)
+        : _scheduler(scheduler) {
+      period_us = us;
+    }
+    /*!
+     *    @brief  The first poll is the wake-up
+     *    @return Always true
+     */
+    bool poll(void) override { return true; }
+    /*!
+     *    @brief  Only zero-length sleeps complete immediately
+     *    @return True if there is nothing to wait for
+     */
+    bool await_ready(void) { return period_us == 0; }
+    /*!
+     *    @brief  Queue the wake-up
+     *    @param  h The sleeping coroutine
+     */
+    void await_suspend(std::coroutine_handle<> h) {
+      handle = h;
+      _scheduler->schedule(this, _scheduler->now_us() + period_us);
+    }
+    /*!
+     *    @brief  Nothing to return
+     */
+    void await_resume(void) {}
+
+  private:
+    Adafruit_LIS3MDL_Scheduler *_scheduler;
+  };
+
+  void spawn(Adafruit_LIS3MDL_Task task);
+  void run(void);
+  bool runOnce(void);
+  void schedule(Adafruit_LIS3MDL_Waiter *waiter, uint64_t when_us);
+  static uint64_t now_us(void);
+
+  /*!
+   *    @brief  Await this to suspend the calling task
+   *    @param  us Time to sleep
+   *    @return An awaitable
+   */
+  Sleep sleep(uint32_t us) { return Sleep(this, us); }
+
+  /*!
+   *    @brief  Tasks spawned and not yet finished
+   *    @return Task count
+   */
+  size_t tasks(void) const { return _live; }
+
+private:
+  friend struct Adafruit_LIS3MDL_Task::promise_type;
+
+  /** One pending poll */
+  struct Entry {
+    uint64_t when_us;                ///< Deadline
+    uint64_t order;                  ///< Tie breaker, first come first served
+    Adafruit_LIS3MDL_Waiter *waiter; ///< What to poll
+    /*!
+     *    @brief  Heap order, earliest deadline on top
+     *    @param  other Entry to compare with
+     *    @return True if this entry is due after other
+     */
+    bool operator<(const Entry &other) const {
+      if (when_us != other.when_us)
+        return when_us > other.when_us;
+      return order > other.order;
+    }
+  };
+
+  std::deque<std::coroutine_handle<>> _ready;
+  std::priority_queue<Entry> _timers;
+  uint64_t _order = 0;
+  size_t _live = 0;
+};
+
+/** Awaitable operations on one sensor, driven by a scheduler */
+class Adafruit_LIS3MDL_Async {
+public:
+  /** Base of the sensor awaitables: poll inline first, then on a timer */
+  class Operation : public Adafruit_LIS3MDL_Waiter {
+  public:
+    /*!
+     *    @brief  Poll once before suspending, so data that is already
+     *            waiting costs no trip through the scheduler
+     *    @return True if the operation completed
+     */
+    bool await_ready(void) { return poll(); }
+    /*!
+     *    @brief  Queue the next poll
+     *    @param  h The waiting coroutine
+     */
+    void await_suspend(std::coroutine_handle<> h) {
+      handle = h;
+      _async->_scheduler->schedule(this, Adafruit_LIS3MDL_Scheduler::now_us() +
+                                             period_us);
+    }
+
+  protected:
+    /*!
+     *    @brief  Set up an operation
+     *    @param  async The sensor to poll
+     */
+    explicit Operation(Adafruit_LIS3MDL_Async *async) : _async(async) {
+      period_us = async->_pollPeriod_us;
+    }
+    bool fetch(lis3mdl_sample_t *sample);
+
+    Adafruit_LIS3MDL_Async *_async; ///< The sensor being polled
+  };
+
+  /** Completes with the next new sample */
+  class NextSample : public Operation {
+  public:
+    /*!
+     *    @brief  Set up the wait
+     *    @param  async The sensor to poll
+     */
+    explicit NextSample(Adafruit_LIS3MDL_Async *async) : Operation(async) {}
+    /*!
+     *    @brief  Read STATUS + XYZ once
+     *    @return True if a new sample arrived
+     */
+    bool poll(void) override { return fetch(&_sample); }
+    /*!
+     *    @brief  Hand over the sample
+     *    @return The new sample
+     */
+    lis3mdl_sample_t await_resume(void) { return _sample; }
+
+  private:
+    lis3mdl_sample_t _sample;
+  };
+
+  /** Completes once a caller-provided span is full of new samples */
+  class Samples : public Operation {
+  public:
+    /*!
+     *    @brief  Set up the wait
+     *    @param  async The sensor to poll
+     *    @param  out Where to store the samples
+     */
+    Samples(Adafruit_LIS3MDL_Async *async, std::span<lis3mdl_sample_t> out)
+        : Operation(async), _out(out) {}
+    /*!
+     *    @brief  Read STATUS + XYZ once and keep a new sample
+     *    @return True once the span is full
+     */
+    bool poll(void) override {
+      if (_count < _out.size() && fetch(&_out[_count]))
+        _count++;
+      return _count == _out.size();
+    }
+    /*!
+     *    @brief  Report how many samples were stored
+     *    @return The size of the span
+     */
+    size_t await_resume(void) { return _count; }
+
+  private:
+    std::span<lis3mdl_sample_t> _out;
+    size_t _count = 0;
+  };
+
+  /** Completes with the first sample beyond a threshold on a chosen axis */
+  class Threshold : public Operation {
+  public:
+    /*!
+     *    @brief  Set up the wait
+     *    @param  async The sensor to poll
+     *    @param  threshold Absolute value to exceed, in raw units
+     *    @param  axes Bit 0 for X, bit 1 for Y, bit 2 for Z
+     */
+    Threshold(Adafruit_LIS3MDL_Async *async, uint16_t threshold, uint8_t axes)
+        : Operation(async), _threshold(threshold), _axes(axes) {}
+    bool poll(void) override;
+    /*!
+     *    @brief  Hand over the sample that crossed the threshold
+     *    @return The sample
+     */
+    lis3mdl_sample_t await_resume(void) { return _sample; }
+
+  private:
+    lis3mdl_sample_t _sample;
+    uint16_t _threshold;
+    uint8_t _axes;
+  };
+
+  Adafruit_LIS3MDL_Async(Adafruit_LIS3MDL_Scheduler *scheduler,
+                         Adafruit_LIS3MDL *sensor, uint32_t pollPeriod_us = 0);
+
+  /*!
+   *    @brief  Await the next new sample
+   *    @return An awaitable yielding lis3mdl_sample_t
+   */
+  NextSample nextSample(void) { return NextSample(this); }
+  /*!
+   *    @brief  Await enough new samples to fill a span
+   *    @param  out Where to store them
+   *    @return An awaitable yielding the number stored
+   */
+  Samples samples(std::span<lis3mdl_sample_t> out) {
+    return Samples(this, out);
+  }
+  /*!
+   *    @brief  Await a sample whose magnitude on any selected axis is above
+   *            a threshold, compared like the INT_THS hardware comparator
+   *    @param  threshold Absolute value to exceed, in raw units
+   *    @param  axes Bit 0 for X, bit 1 for Y, bit 2 for Z
+   *    @return An awaitable yielding the sample that crossed it
+   */
+  Threshold threshold(uint16_t threshold, uint8_t axes = 0x07) {
+    return Threshold(this, threshold, axes);
+  }
+
+  /*!
+   *    @brief  Bus reads that failed; polling carries on after a failure
+   *    @return Error count
+   */
+  uint32_t errors(void) const { return _errors; }
+
+private:
+  Adafruit_LIS3MDL_Scheduler *_scheduler;
+  Adafruit_LIS3MDL *_sensor;
+  uint32_t _pollPeriod_us;
+  uint32_t _errors = 0;
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*!
+ * @file     Adafruit_LIS3MDL_I2CBatch.cpp
+ *
+ * Batched register reads for arrays of LIS3MDLs sharing an i2c-dev bus. The
+ * queued reads stay in place after transfer(), so a polling loop builds the
+ * batch once and then pays one kernel call per cycle for every sensor.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_I2CBatch.h"
+
+/*!
+ *    @brief  Create an empty batch
+ *    @param  wire The bus all queued devices are on
+ */
+Adafruit_LIS3MDL_I2CBatch::Adafruit_LIS3MDL_I2CBatch(TwoWire *wire)
+    : _wire(wire) {}
+
+/*!
+ *    @brief  Queue a burst read of arbitrary registers
+ *    @param  i2c_addr Address of the device
+ *    @param  reg First register to read
+ *    @param  buffer Where the data lands after transfer()
+ *    @param  len Number of bytes to read
+ *    @return False if the batch is full
+ */
+bool Adafruit_LIS3MDL_I2CBatch::addRead(uint8_t i2c_addr, uint8_t reg,
+                                        uint8_t *buffer, uint8_t len) {
+  return queue(i2c_addr, reg, buffer, len, NULL);
+}
+
+/*!
+ *    @brief  Queue a STATUS + XYZ burst, decoded into a sample on transfer()
+ *    @param  i2c_addr Address of the LIS3MDL
+ *    @param  sample Where the decoded reading lands after transfer()
+ *    @return False if the batch is full
+ */
+bool Adafruit_LIS3MDL_I2CBatch::addSample(uint8_t i2c_addr,
+                                          lis3mdl_sample_t *sample) {
+  return queue(i2c_addr, LIS3MDL_REG_STATUS, _raw[_count], 7, sample);
+}
+
+bool Adafruit_LIS3MDL_I2CBatch::queue(uint8_t i2c_addr, uint8_t reg,
+                                      uint8_t *buffer, uint8_t len,
+                                      lis3mdl_sample_t *sample) {
+  if (_count >= LIS3MDL_I2C_BATCH_MAX || len > LIS3MDL_I2C_BATCH_READ_MAX)
+    return false;
+
+  _regs[_count] = reg;
+  _samples[_count] = sample;
+
+  struct i2c_msg *msgs = &_msgs[_count * 2];
+  msgs[0].addr = i2c_addr;
+  msgs[0].flags = 0;
+  msgs[0].len = 1;
+  msgs[0].buf = &_regs[_count];
+  msgs[1].addr = i2c_addr;
+  msgs[1].flags = I2C_M_RD;
+  msgs[1].len = len;
+  msgs[1].buf = buffer;
+
+  _count++;
+  return true;
+}
+
+/*!
+ *    @brief  Perform every queued read in one I2C_RDWR ioctl and decode the
+ *            sample entries. All samples share the completion timestamp.
+ *    @return True if every read succeeded
+ */
+bool Adafruit_LIS3MDL_I2CBatch::transfer(void) {
+  if (_count == 0)
+    return true;
+  if (!_wire->transfer(_msgs, _count * 2))
+    return false;
+
+  uint32_t now = millis();
+  for (uint8_t i = 0; i < _count; i++) {
+    if (!_samples[i])
+      continue;
+    lis3mdl_unpackSample(_raw[i], _samples[i]);
+    _samples[i]->timestamp = now;
+  }
+  return true;
+}
+
+/*!
+ *    @brief  Drop all queued reads
+ */
+void Adafruit_LIS3MDL_I2CBatch::clear(void) { _count = 0; }
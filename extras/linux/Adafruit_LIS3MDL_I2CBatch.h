@@ -0,0 +1,49 @@
+/*!
+ * @file     Adafruit_LIS3MDL_I2CBatch.h
+ *
+ * Reads from several LIS3MDLs on one Linux I2C bus in a single ioctl
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_I2CBATCH_H
+#define ADAFRUIT_LIS3MDL_I2CBATCH_H
+
+#include <Adafruit_LIS3MDL.h>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+
+/** Reads per batch, each read is an address write plus a data read */
+#define LIS3MDL_I2C_BATCH_MAX (I2C_RDWR_IOCTL_MAX_MSGS / 2)
+
+/** Longest read a batch entry can hold */
+#define LIS3MDL_I2C_BATCH_READ_MAX 32
+
+/** A set of register reads issued together as one I2C_RDWR transaction */
+class Adafruit_LIS3MDL_I2CBatch {
+public:
+  Adafruit_LIS3MDL_I2CBatch(TwoWire *wire = &Wire);
+
+  bool addRead(uint8_t i2c_addr, uint8_t reg, uint8_t *buffer, uint8_t len);
+  bool addSample(uint8_t i2c_addr, lis3mdl_sample_t *sample);
+  bool transfer(void);
+  void clear(void);
+
+  /*!
+   *    @brief  Number of queued reads
+   *    @return Reads that the next transfer() will perform
+   */
+  uint8_t count(void) { return _count; }
+
+private:
+  bool queue(uint8_t i2c_addr, uint8_t reg, uint8_t *buffer, uint8_t len,
+             lis3mdl_sample_t *sample);
+
+  TwoWire *_wire;
+  uint8_t _count = 0;
+  struct i2c_msg _msgs[LIS3MDL_I2C_BATCH_MAX * 2];
+  uint8_t _regs[LIS3MDL_I2C_BATCH_MAX];
+  uint8_t _raw[LIS3MDL_I2C_BATCH_MAX][7];
+  lis3mdl_sample_t *_samples[LIS3MDL_I2C_BATCH_MAX];
+};
+
+#endif
@@ -0,0 +1,366 @@
+/*!
+ * @file     Adafruit_LIS3MDL_IIO.cpp
+ *
+ * Backend for boards where the in-kernel st_magn driver owns the LIS3MDL.
+ * Configuration goes through sysfs attributes; samples come from the
+ * triggered buffer, many scan records per read() of /dev/iio:deviceN rather
+ * than one sysfs read per axis per sample.
+ *
+ * Both roots are constructor arguments, so the backend can be pointed at a
+ * fake sysfs/devfs tree made of plain files.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_IIO.h"
+#include "lis3mdl_linux_io.h"
+
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+
+/** How many iio:deviceN entries begin() looks at */
+#define LIS3MDL_IIO_MAX_DEVICES 64
+
+// LSB per gauss for each lis3mdl_range_t
+static const uint16_t lis3mdl_iio_lsbPerGauss[4] = {6842, 3421, 2281, 1711};
+
+static const char *lis3mdl_iio_channels[4] = {"in_magn_x", "in_magn_y",
+                                              "in_magn_z", "in_timestamp"};
+
+/*!
+ *    @brief  Create a backend, no files are touched until begin()
+ *    @param  sysfsRoot Directory holding the iio:deviceN entries
+ *    @param  devRoot Directory holding the iio:deviceN character devices
+ */
+Adafruit_LIS3MDL_IIO::Adafruit_LIS3MDL_IIO(const char *sysfsRoot,
+                                           const char *devRoot)
+    : _sysfsRoot(sysfsRoot), _devRoot(devRoot) {
+  _devName[0] = 0;
+  memset(_chan, 0, sizeof(_chan));
+}
+
+Adafruit_LIS3MDL_IIO::~Adafruit_LIS3MDL_IIO(void) { stopCapture(); }
+
+/*!
+ *    @brief  Find the IIO device whose name attribute matches
+ *    @param  name Device name as registered by st_magn
+ *    @return True if the device was found
+ */
+bool Adafruit_LIS3MDL_IIO::begin(const char *name) {
+  char value[64];
+
+  for (int i = 0; i < LIS3MDL_IIO_MAX_DEVICES; i++) {
+    snprintf(_devName, sizeof(_devName), "iio:device%d", i);
+    if (readAttr("name", value, sizeof(value)) && strcmp(value, name) == 0) {
+      if (readAttr("in_magn_scale", value, sizeof(value)))
+        _scale = strtof(value, NULL);
+      return true;
+    }
+  }
+  _devName[0] = 0;
+  return false;
+}
+
+bool Adafruit_LIS3MDL_IIO::readAttr(const char *attr, char *value,
+                                    size_t len) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s/%s", _sysfsRoot, _devName, attr);
+
+  const lis3mdl_linux_io_t *io = lis3mdl_linux_io();
+  int fd = io->open(path, O_RDONLY);
+  if (fd < 0)
+    return false;
+  ssize_t n = io->read(fd, value, len - 1);
+  io->close(fd);
+  if (n < 0)
+    return false;
+
+  // Attributes end with a newline
+  while (n > 0 && (value[n - 1] == '\n' || value[n - 1] == ' '))
+    n--;
+  value[n] = 0;
+  return true;
+}
+
+bool Adafruit_LIS3MDL_IIO::writeAttr(const char *attr, const char *value) {
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s/%s", _sysfsRoot, _devName, attr);
+
+  const lis3mdl_linux_io_t *io = lis3mdl_linux_io();
+  int fd = io->open(path, O_WRONLY | O_TRUNC);
+  if (fd < 0)
+    return false;
+  size_t len = strlen(value);
+  ssize_t n = io->write(fd, value, len);
+  io->close(fd);
+  return n == (ssize_t)len;
+}
+
+/*!
+ *    @brief  Select the full-scale range from in_magn_scale_available
+ *    @param  range Enumerated lis3mdl_range_t
+ *    @return True if the kernel accepted the scale
+ */
+bool Adafruit_LIS3MDL_IIO::setRange(lis3mdl_range_t range) {
+  char avail[128];
+  if (!readAttr("in_magn_scale_available", avail, sizeof(avail)))
+    return false;
+
+  // Pick the listed scale closest to this range's gauss per LSB
+  float target = 1.0f / lis3mdl_iio_lsbPerGauss[range & 0x3];
+  char best[24] = "";
+  float bestErr = 0;
+  for (char *tok = strtok(avail, " "); tok; tok = strtok(NULL, " ")) {
+    float err = fabsf(strtof(tok, NULL) - target);
+    if (!best[0] || err < bestErr) {
+      snprintf(best, sizeof(best), "%s", tok);
+      bestErr = err;
+    }
+  }
+  if (!best[0] || !writeAttr("in_magn_scale", best))
+    return false;
+  _scale = strtof(best, NULL);
+  return true;
+}
+
+/*!
+ *    @brief  Read the full-scale range back from in_magn_scale
+ *    @return Enumerated lis3mdl_range_t closest to the kernel's scale
+ */
+lis3mdl_range_t Adafruit_LIS3MDL_IIO::getRange(void) {
+  char value[24];
+  if (readAttr("in_magn_scale", value, sizeof(value)))
+    _scale = strtof(value, NULL);
+
+  uint8_t best = 0;
+  for (uint8_t r = 1; r < 4; r++) {
+    if (fabsf(_scale - 1.0f / lis3mdl_iio_lsbPerGauss[r]) <
+        fabsf(_scale - 1.0f / lis3mdl_iio_lsbPerGauss[best]))
+      best = r;
+  }
+  return (lis3mdl_range_t)best;
+}
+
+/*!
+ *    @brief  Set the sampling frequency to the slowest listed rate that is
+ *            at least the requested one
+ *    @param  dataRate Enumerated lis3mdl_dataRate_t
+ *    @return True if the kernel accepted the rate
+ */
+bool Adafruit_LIS3MDL_IIO::setDataRate(lis3mdl_dataRate_t dataRate) {
+  char avail[128];
+  if (!readAttr("sampling_frequency_available", avail, sizeof(avail)))
+    return false;
+
+  float target = lis3mdl_dataRateToMilliHz(dataRate) / 1000.0f;
+  char best[24] = "", fastest[24] = "";
+  float bestHz = 0, fastestHz = 0;
+  for (char *tok = strtok(avail, " "); tok; tok = strtok(NULL, " ")) {
+    float hz = strtof(tok, NULL);
+    if (hz >= target && (!best[0] || hz < bestHz)) {
+      snprintf(best, sizeof(best), "%s", tok);
+      bestHz = hz;
+    }
+    if (hz > fastestHz) {
+      snprintf(fastest, sizeof(fastest), "%s", tok);
+      fastestHz = hz;
+    }
+  }
+  return writeAttr("sampling_frequency", best[0] ? best : fastest);
+}
+
+/*!
+ *    @brief  Read the sampling frequency back
+ *    @return Enumerated lis3mdl_dataRate_t closest to the kernel's rate
+ */
+lis3mdl_dataRate_t Adafruit_LIS3MDL_IIO::getDataRate(void) {
+  static const lis3mdl_dataRate_t rates[] = {
+      LIS3MDL_DATARATE_0_625_HZ, LIS3MDL_DATARATE_1_25_HZ,
+      LIS3MDL_DATARATE_2_5_HZ,   LIS3MDL_DATARATE_5_HZ,
+      LIS3MDL_DATARATE_10_HZ,    LIS3MDL_DATARATE_20_HZ,
+      LIS3MDL_DATARATE_40_HZ,    LIS3MDL_DATARATE_80_HZ,
+      LIS3MDL_DATARATE_155_HZ,   LIS3MDL_DATARATE_300_HZ,
+      LIS3MDL_DATARATE_560_HZ,   LIS3MDL_DATARATE_1000_HZ};
+  char value[24];
+  if (!readAttr("sampling_frequency", value, sizeof(value)))
+    return LIS3MDL_DATARATE_0_625_HZ;
+
+  float hz = strtof(value, NULL);
+  lis3mdl_dataRate_t best = rates[0];
+  for (uint8_t i = 1; i < sizeof(rates) / sizeof(rates[0]); i++) {
+    if (fabsf(lis3mdl_dataRateToMilliHz(rates[i]) / 1000.0f - hz) <
+        fabsf(lis3mdl_dataRateToMilliHz(best) / 1000.0f - hz))
+      best = rates[i];
+  }
+  return best;
+}
+
+bool Adafruit_LIS3MDL_IIO::readChannel(const char *channel,
+                                       lis3mdl_iio_channel_t *chan) {
+  char attr[64], value[32];
+  char endian[3], sign;
+  unsigned bits, storage, shift;
+
+  snprintf(attr, sizeof(attr), "scan_elements/%s_en", channel);
+  if (!writeAttr(attr, "1"))
+    return false;
+
+  snprintf(attr, sizeof(attr), "scan_elements/%s_index", channel);
+  if (!readAttr(attr, value, sizeof(value)))
+    return false;
+  chan->index = atoi(value);
+
+  // Format is [be|le]:[s|u]bits/storagebits>>shift
+  snprintf(attr, sizeof(attr), "scan_elements/%s_type", channel);
+  if (!readAttr(attr, value, sizeof(value)) ||
+      sscanf(value, "%2[bl]e:%c%u/%u>>%u", endian, &sign, &bits, &storage,
+             &shift) != 5 ||
+      storage == 0 || storage > 64 || storage % 8 || bits == 0 ||
+      bits > storage || shift > storage - bits)
+    return false;
+
+  chan->bigEndian = (endian[0] == 'b');
+  chan->isSigned = (sign == 's');
+  chan->bits = bits;
+  chan->storage = storage;
+  chan->shift = shift;
+  chan->enabled = true;
+  return true;
+}
+
+/*!
+ *    @brief  Enable the X/Y/Z and timestamp scan elements, attach a trigger
+ *            and start the kernel buffer
+ *    @param  trigger Trigger name, NULL for the sensor's own data-ready
+ *            trigger ("<name>-trigger")
+ *    @param  bufferLength Kernel buffer depth in scans
+ *    @param  nonBlocking If true, readSamples() returns 0 instead of waiting
+ *    @return True if capture started
+ */
+bool Adafruit_LIS3MDL_IIO::startCapture(const char *trigger,
+                                        uint32_t bufferLength,
+                                        bool nonBlocking) {
+  char value[64];
+
+  stopCapture();
+  writeAttr("buffer/enable", "0");
+
+  for (uint8_t i = 0; i < 4; i++) {
+    if (!readChannel(lis3mdl_iio_channels[i], &_chan[i]))
+      return false;
+  }
+
+  // Scan elements are packed in index order, each aligned to its size
+  uint16_t offset = 0, align = 1;
+  for (uint8_t index = 0; index < 64; index++) {
+    for (uint8_t i = 0; i < 4; i++) {
+      if (!_chan[i].enabled || _chan[i].index != index)
+        continue;
+      uint8_t bytes = _chan[i].storage / 8;
+      offset = (offset + bytes - 1) / bytes * bytes;
+      _chan[i].offset = offset;
+      offset += bytes;
+      if (bytes > align)
+        align = bytes;
+    }
+  }
+  _recordSize = (offset + align - 1) / align * align;
+
+  if (!trigger) {
+    char name[32];
+    if (!readAttr("name", name, sizeof(name)))
+      return false;
+    snprintf(value, sizeof(value), "%s-trigger", name);
+    trigger = value;
+  }
+  if (!writeAttr("trigger/current_trigger", trigger))
+    return false;
+
+  char length[16];
+  snprintf(length, sizeof(length), "%u", (unsigned)bufferLength);
+  if (!writeAttr("buffer/length", length) ||
+      !writeAttr("buffer/enable", "1"))
+    return false;
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%s", _devRoot, _devName);
+  _fd = lis3mdl_linux_io()->open(path,
+                                 O_RDONLY | (nonBlocking ? O_NONBLOCK : 0));
+  return _fd >= 0;
+}
+
+int64_t Adafruit_LIS3MDL_IIO::extract(const uint8_t *record,
+                                      const lis3mdl_iio_channel_t *chan) {
+  uint8_t bytes = chan->storage / 8;
+  uint64_t raw = 0;
+
+  for (uint8_t i = 0; i < bytes; i++) {
+    uint8_t b = record[chan->offset + (chan->bigEndian ? i : bytes - 1 - i)];
+    raw = (raw << 8) | b;
+  }
+  if (chan->bits == 0 || chan->shift >= 64)
+    return 0; // rejected by readChannel(), never shift by 64 or more
+  raw >>= chan->shift;
+  if (chan->bits < 64) {
+    raw &= (1ULL << chan->bits) - 1;
+    if (chan->isSigned && (raw & (1ULL << (chan->bits - 1))))
+      raw |= ~((1ULL << chan->bits) - 1);
+  }
+  return (int64_t)raw;
+}
+
+/*!
+ *    @brief  Fetch buffered samples, many scan records per read() call. The
+ *            status byte is set to ZYXDA, since the kernel only pushes
+ *            complete new scans, and the timestamp is the kernel's, in ms.
+ *    @param  samples Where to store the samples
+ *    @param  count Maximum number of samples to fetch
+ *    @return Number of samples stored
+ */
+size_t Adafruit_LIS3MDL_IIO::readSamples(lis3mdl_sample_t *samples,
+                                         size_t count) {
+  uint8_t buffer[4096];
+  size_t done = 0;
+
+  if (_fd < 0 || _recordSize == 0)
+    return 0;
+
+  while (done < count) {
+    size_t want = count - done;
+    if (want > sizeof(buffer) / _recordSize)
+      want = sizeof(buffer) / _recordSize;
+
+    ssize_t n = lis3mdl_linux_io()->read(_fd, buffer, want * _recordSize);
+    if (n <= 0)
+      break;
+
+    size_t records = n / _recordSize;
+    for (size_t r = 0; r < records; r++) {
+      const uint8_t *record = buffer + r * _recordSize;
+      lis3mdl_sample_t *s = &samples[done + r];
+      s->x = (int16_t)extract(record, &_chan[0]);
+      s->y = (int16_t)extract(record, &_chan[1]);
+      s->z = (int16_t)extract(record, &_chan[2]);
+      s->status = 0x08; // ZYXDA
+      s->flags = lis3mdl_sampleFlags(s);
+      s->timestamp = (uint32_t)(extract(record, &_chan[3]) / 1000000);
+    }
+    done += records;
+    if (records < want)
+      break; // the kernel had no more complete scans
+  }
+  return done;
+}
+
+/*!
+ *    @brief  Stop the kernel buffer and close the character device
+ */
+void Adafruit_LIS3MDL_IIO::stopCapture(void) {
+  if (_fd < 0)
+    return;
+  lis3mdl_linux_io()->close(_fd);
+  _fd = -1;
+  writeAttr("buffer/enable", "0");
+}
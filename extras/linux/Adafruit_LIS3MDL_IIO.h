@@ -0,0 +1,71 @@
+/*!
+ * @file     Adafruit_LIS3MDL_IIO.h
+ *
+ * LIS3MDL access through the kernel's st_magn IIO driver, with triggered
+ * buffered capture from the /dev/iio:deviceN character device
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_IIO_H
+#define ADAFRUIT_LIS3MDL_IIO_H
+
+#include <Adafruit_LIS3MDL.h>
+
+/** Layout of one channel in a buffered scan, from scan_elements */
+typedef struct {
+  bool enabled;    ///< Channel is part of the scan
+  bool isSigned;   ///< 's' (true) or 'u' (false)
+  bool bigEndian;  ///< 'be' (true) or 'le' (false)
+  uint8_t bits;    ///< Valid bits
+  uint8_t storage; ///< Storage bits
+  uint8_t shift;   ///< Right shift to apply
+  uint8_t index;   ///< Position in the scan
+  uint16_t offset; ///< Byte offset in the scan record
+} lis3mdl_iio_channel_t;
+
+/** Adafruit_LIS3MDL-style access to a sensor bound to the IIO driver */
+class Adafruit_LIS3MDL_IIO {
+public:
+  Adafruit_LIS3MDL_IIO(const char *sysfsRoot = "/sys/bus/iio/devices",
+                       const char *devRoot = "/dev");
+  ~Adafruit_LIS3MDL_IIO(void);
+
+  bool begin(const char *name = "lis3mdl");
+  bool setRange(lis3mdl_range_t range);
+  lis3mdl_range_t getRange(void);
+  bool setDataRate(lis3mdl_dataRate_t dataRate);
+  lis3mdl_dataRate_t getDataRate(void);
+
+  bool startCapture(const char *trigger = NULL, uint32_t bufferLength = 128,
+                    bool nonBlocking = false);
+  size_t readSamples(lis3mdl_sample_t *samples, size_t count);
+  void stopCapture(void);
+
+  /*!
+   *    @brief  Conversion factor reported by the kernel
+   *    @return Gauss per LSB for the current range
+   */
+  float gaussPerLSB(void) { return _scale; }
+
+  /*!
+   *    @brief  Size of one buffered scan record
+   *    @return Bytes per sample in /dev/iio:deviceN
+   */
+  uint16_t recordSize(void) { return _recordSize; }
+
+private:
+  bool readAttr(const char *attr, char *value, size_t len);
+  bool writeAttr(const char *attr, const char *value);
+  bool readChannel(const char *channel, lis3mdl_iio_channel_t *chan);
+  int64_t extract(const uint8_t *record, const lis3mdl_iio_channel_t *chan);
+
+  const char *_sysfsRoot;
+  const char *_devRoot;
+  char _devName[32];
+  int _fd = -1;
+  float _scale = 0;
+  uint16_t _recordSize = 0;
+  lis3mdl_iio_channel_t _chan[4]; // x, y, z, timestamp
+};
+
+#endif
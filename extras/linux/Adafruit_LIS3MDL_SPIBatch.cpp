@@ -0,0 +1,121 @@
+/*!
+ * @file     Adafruit_LIS3MDL_SPIBatch.cpp
+ *
+ * Batched spidev reads. Each queued read is one full-duplex transfer: the
+ * address byte with the LIS3MDL read (bit 7) and auto-increment (bit 6) bits
+ * set, followed by the data bytes. Reads on the same spidev node are chained
+ * with cs_change into a single SPI_IOC_MESSAGE(n). spidev binds exactly one
+ * chip select to each node, so sensors on different chip selects need one
+ * ioctl per node; transfer() never issues more than that.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_SPIBatch.h"
+#include "lis3mdl_linux_io.h"
+
+#include <linux/spi/spidev.h>
+
+/*!
+ *    @brief  Queue a burst read of arbitrary registers
+ *    @param  dev A begun spidev device
+ *    @param  reg First register to read
+ *    @param  buffer Where the data lands after transfer()
+ *    @param  len Number of bytes to read
+ *    @return False if the batch is full
+ */
+bool Adafruit_LIS3MDL_SPIBatch::addRead(Adafruit_SPIDevice *dev, uint8_t reg,
+                                        uint8_t *buffer, uint8_t len) {
+  return queue(dev, reg, buffer, len, NULL);
+}
+
+/*!
+ *    @brief  Queue a STATUS + XYZ burst, decoded into a sample on transfer()
+ *    @param  dev A begun spidev device for the LIS3MDL
+ *    @param  sample Where the decoded reading lands after transfer()
+ *    @return False if the batch is full
+ */
+bool Adafruit_LIS3MDL_SPIBatch::addSample(Adafruit_SPIDevice *dev,
+                                          lis3mdl_sample_t *sample) {
+  return queue(dev, LIS3MDL_REG_STATUS, NULL, 7, sample);
+}
+
+bool Adafruit_LIS3MDL_SPIBatch::queue(Adafruit_SPIDevice *dev, uint8_t reg,
+                                      uint8_t *buffer, uint8_t len,
+                                      lis3mdl_sample_t *sample) {
+  if (_count >= LIS3MDL_SPI_BATCH_MAX || len > LIS3MDL_SPI_BATCH_READ_MAX)
+    return false;
+
+  _devs[_count] = dev;
+  _regs[_count] = reg;
+  _lens[_count] = len;
+  _buffers[_count] = buffer;
+  _samples[_count] = sample;
+  _count++;
+  return true;
+}
+
+/*!
+ *    @brief  Perform every queued read, one SPI_IOC_MESSAGE per spidev node,
+ *            and decode the sample entries
+ *    @return True if every ioctl succeeded
+ */
+bool Adafruit_LIS3MDL_SPIBatch::transfer(void) {
+  struct spi_ioc_transfer xfers[LIS3MDL_SPI_BATCH_MAX];
+  uint8_t members[LIS3MDL_SPI_BATCH_MAX];
+  bool done[LIS3MDL_SPI_BATCH_MAX] = {false};
+  bool ok = true;
+
+  _ioctls = 0;
+  for (uint8_t i = 0; i < _count; i++) {
+    if (done[i])
+      continue;
+
+    // Gather every read for this node, keeping queue order. queue() caps
+    // _count at LIS3MDL_SPI_BATCH_MAX, and entry i is always a member.
+    Adafruit_SPIDevice *dev = _devs[i];
+    uint8_t n = 0;
+    for (uint8_t j = i; j < _count; j++) {
+      if (_devs[j] != dev)
+        continue;
+      done[j] = true;
+
+      uint8_t *frame = _frames[j];
+      memset(frame, 0, _lens[j] + 1);
+      frame[0] = _regs[j] | 0x80 | 0x40; // read, auto-increment
+
+      if (n)
+        xfers[n - 1].cs_change = 1; // deselect between reads
+      memset(&xfers[n], 0, sizeof(xfers[n]));
+      xfers[n].tx_buf = (unsigned long)frame;
+      xfers[n].rx_buf = (unsigned long)frame;
+      xfers[n].len = _lens[j] + 1;
+      xfers[n].speed_hz = dev->frequency();
+      members[n++] = j;
+    }
+
+    _ioctls++;
+    if (lis3mdl_linux_io()->ioctl(dev->fd(), SPI_IOC_MESSAGE(n), xfers) < 0) {
+      ok = false;
+      continue;
+    }
+
+    uint32_t now = millis();
+    for (uint8_t k = 0; k < n; k++) {
+      uint8_t j = members[k];
+      if (_samples[j]) {
+        lis3mdl_unpackSample(_frames[j] + 1, _samples[j]);
+        _samples[j]->timestamp = now;
+      } else {
+        memcpy(_buffers[j], _frames[j] + 1, _lens[j]);
+      }
+    }
+  }
+  return ok;
+}
+
+/*!
+ *    @brief  Drop all queued reads
+ */
+void Adafruit_LIS3MDL_SPIBatch::clear(void) { _count = 0; }
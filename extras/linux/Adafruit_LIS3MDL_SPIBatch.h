@@ -0,0 +1,55 @@
+/*!
+ * @file     Adafruit_LIS3MDL_SPIBatch.h
+ *
+ * Queues register reads from many LIS3MDLs on Linux spidev and issues them
+ * as multi-transfer SPI_IOC_MESSAGE(n) calls
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_SPIBATCH_H
+#define ADAFRUIT_LIS3MDL_SPIBATCH_H
+
+#include <Adafruit_LIS3MDL.h>
+
+/** Reads per batch */
+#define LIS3MDL_SPI_BATCH_MAX 32
+
+/** Longest read a batch entry can hold */
+#define LIS3MDL_SPI_BATCH_READ_MAX 32
+
+/** A set of register reads grouped into as few spidev ioctls as possible */
+class Adafruit_LIS3MDL_SPIBatch {
+public:
+  bool addRead(Adafruit_SPIDevice *dev, uint8_t reg, uint8_t *buffer,
+               uint8_t len);
+  bool addSample(Adafruit_SPIDevice *dev, lis3mdl_sample_t *sample);
+  bool transfer(void);
+  void clear(void);
+
+  /*!
+   *    @brief  Number of queued reads
+   *    @return Reads that the next transfer() will perform
+   */
+  uint8_t count(void) { return _count; }
+
+  /*!
+   *    @brief  Number of ioctls the last transfer() needed
+   *    @return One per distinct spidev node in the batch
+   */
+  uint8_t lastIoctls(void) { return _ioctls; }
+
+private:
+  bool queue(Adafruit_SPIDevice *dev, uint8_t reg, uint8_t *buffer,
+             uint8_t len, lis3mdl_sample_t *sample);
+
+  uint8_t _count = 0;
+  uint8_t _ioctls = 0;
+  Adafruit_SPIDevice *_devs[LIS3MDL_SPI_BATCH_MAX];
+  uint8_t _regs[LIS3MDL_SPI_BATCH_MAX];
+  uint8_t _lens[LIS3MDL_SPI_BATCH_MAX];
+  uint8_t *_buffers[LIS3MDL_SPI_BATCH_MAX];
+  lis3mdl_sample_t *_samples[LIS3MDL_SPI_BATCH_MAX];
+  uint8_t _frames[LIS3MDL_SPI_BATCH_MAX][LIS3MDL_SPI_BATCH_READ_MAX + 1];
+};
+
+#endif
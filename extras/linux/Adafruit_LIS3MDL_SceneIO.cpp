@@ -0,0 +1,153 @@
+/*!
+ * @file     Adafruit_LIS3MDL_SceneIO.cpp
+ *
+ * System call table that answers i2c-dev and spidev requests from an
+ * Adafruit_LIS3MDL_Scene. Every bus node opens to the same emulated part and
+ * register accesses are timed with micros(), so data-ready, overrun and
+ * single-shot behave as they would on hardware polled at the same times.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_SceneIO.h"
+#include "lis3mdl_linux_io.h"
+
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+#include <linux/spi/spidev.h>
+
+#define LIS3MDL_SCENE_FD 0x3D ///< Descriptor handed out by open()
+
+static Adafruit_LIS3MDL_Scene *lis3mdl_scene = NULL;
+static uint8_t lis3mdl_scenePointer = 0; // I2C register address
+
+static int lis3mdl_scene_open(const char *path, int flags) {
+  (void)path;
+  (void)flags;
+  return LIS3MDL_SCENE_FD;
+}
+
+static int lis3mdl_scene_close(int fd) {
+  return fd == LIS3MDL_SCENE_FD ? 0 : -1;
+}
+
+static ssize_t lis3mdl_scene_read(int fd, void *buf, size_t count) {
+  (void)fd;
+  (void)buf;
+  (void)count;
+  return -1;
+}
+
+static ssize_t lis3mdl_scene_write(int fd, const void *buf, size_t count) {
+  (void)fd;
+  (void)buf;
+  (void)count;
+  return -1;
+}
+
+// Register accesses always auto-increment over I2C
+static int lis3mdl_scene_i2c(struct i2c_rdwr_ioctl_data *data) {
+  uint32_t now = micros();
+
+  for (uint32_t i = 0; i < data->nmsgs; i++) {
+    struct i2c_msg *msg = &data->msgs[i];
+    if (msg->flags & I2C_M_RD) {
+      lis3mdl_scene->readRegisters(lis3mdl_scenePointer, msg->buf, msg->len,
+                                   now);
+      lis3mdl_scenePointer += msg->len;
+    } else if (msg->len) {
+      lis3mdl_scenePointer = msg->buf[0] & 0x7F;
+      lis3mdl_scene->writeRegisters(lis3mdl_scenePointer, msg->buf + 1,
+                                    msg->len - 1, now);
+      lis3mdl_scenePointer += msg->len - 1;
+    }
+  }
+  return data->nmsgs;
+}
+
+// Byte pos of a chip select frame, spread over transfers [first, last]
+static uint8_t *lis3mdl_scene_byte(struct spi_ioc_transfer *xfers,
+                                   uint32_t first, uint32_t last, uint32_t pos,
+                                   bool rx) {
+  for (uint32_t i = first; i <= last; i++) {
+    if (pos < xfers[i].len) {
+      uint64_t buf = rx ? xfers[i].rx_buf : xfers[i].tx_buf;
+      return buf ? (uint8_t *)(uintptr_t)buf + pos : NULL;
+    }
+    pos -= xfers[i].len;
+  }
+  return NULL;
+}
+
+// One chip select frame: an address byte, then data
+static void lis3mdl_scene_frame(struct spi_ioc_transfer *xfers, uint32_t first,
+                                uint32_t last, uint32_t now) {
+  uint32_t len = 0;
+  for (uint32_t i = first; i <= last; i++)
+    len += xfers[i].len;
+
+  uint8_t *cmd = lis3mdl_scene_byte(xfers, first, last, 0, false);
+  if (!cmd || len < 2)
+    return;
+  uint8_t reg = *cmd & 0x3F;
+  bool increment = *cmd & 0x40;
+
+  for (uint32_t pos = 1; pos < len; pos++) {
+    uint8_t value = 0;
+    if (*cmd & 0x80) {
+      lis3mdl_scene->readRegisters(reg, &value, 1, now);
+      uint8_t *rx = lis3mdl_scene_byte(xfers, first, last, pos, true);
+      if (rx)
+        *rx = value;
+    } else {
+      uint8_t *tx = lis3mdl_scene_byte(xfers, first, last, pos, false);
+      if (tx)
+        value = *tx;
+      lis3mdl_scene->writeRegisters(reg, &value, 1, now);
+    }
+    if (increment)
+      reg++;
+  }
+}
+
+static int lis3mdl_scene_spi(unsigned long request, void *arg) {
+  struct spi_ioc_transfer *xfers = (struct spi_ioc_transfer *)arg;
+  uint32_t count = _IOC_SIZE(request) / sizeof(struct spi_ioc_transfer);
+  uint32_t now = micros(), first = 0, total = 0;
+
+  for (uint32_t i = 0; i < count; i++) {
+    total += xfers[i].len;
+    if (xfers[i].cs_change || i == count - 1) {
+      lis3mdl_scene_frame(xfers, first, i, now);
+      first = i + 1;
+    }
+  }
+  return total;
+}
+
+static int lis3mdl_scene_ioctl(int fd, unsigned long request, void *arg) {
+  if (fd != LIS3MDL_SCENE_FD || !lis3mdl_scene)
+    return -1;
+  if (request == I2C_RDWR)
+    return lis3mdl_scene_i2c((struct i2c_rdwr_ioctl_data *)arg);
+  if (_IOC_TYPE(request) == SPI_IOC_MAGIC && _IOC_NR(request) == 0 &&
+      _IOC_DIR(request) == _IOC_WRITE)
+    return lis3mdl_scene_spi(request, arg);
+  return 0; // I2C_SLAVE, SPI mode and speed settings
+}
+
+static const lis3mdl_linux_io_t lis3mdl_scene_io = {
+    lis3mdl_scene_open, lis3mdl_scene_close, lis3mdl_scene_ioctl,
+    lis3mdl_scene_read, lis3mdl_scene_write};
+
+/*!
+ *    @brief  Route every I2C and SPI transfer to an emulated sensor
+ *    @param  scene The scene whose registers answer, or NULL to go back to
+ *            the real system calls. It must outlive its use.
+ */
+void lis3mdl_linux_useScene(Adafruit_LIS3MDL_Scene *scene) {
+  lis3mdl_scene = scene;
+  lis3mdl_scenePointer = 0;
+  lis3mdl_linux_setIO(scene ? &lis3mdl_scene_io : NULL);
+}
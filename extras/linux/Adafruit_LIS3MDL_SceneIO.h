@@ -0,0 +1,16 @@
+/*!
+ * @file     Adafruit_LIS3MDL_SceneIO.h
+ *
+ * Serves the Linux transports from an emulated LIS3MDL, so the driver runs
+ * unchanged against a synthetic scene
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_SCENEIO_H
+#define ADAFRUIT_LIS3MDL_SCENEIO_H
+
+#include <Adafruit_LIS3MDL_Scene.h>
+
+void lis3mdl_linux_useScene(Adafruit_LIS3MDL_Scene *scene);
+
+#endif
@@ -0,0 +1,68 @@
+/*!
+ * @file     Adafruit_LIS3MDL_Seqlock.h
+ *
+ * Single-writer sequence lock for sharing small samples between threads or
+ * processes. The writer never waits; readers retry only if the writer was
+ * in the middle of an update while they copied.
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_SEQLOCK_H
+#define ADAFRUIT_LIS3MDL_SEQLOCK_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*!
+ * A value guarded by a sequence counter. The layout is plain data, so a
+ * zero-filled block of shared memory is a valid, empty instance.
+ */
+template <typename T> struct Adafruit_LIS3MDL_Seqlock {
+  uint32_t seq; ///< Odd while a write is in progress
+  T value;      ///< The protected value
+
+  /*!
+   *    @brief  Publish a new value. Only one writer may call this.
+   *    @param  v The value to store
+   */
+  void write(const T &v) {
+    uint32_t s = __atomic_load_n(&seq, __ATOMIC_RELAXED);
+    __atomic_store_n(&seq, s + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(&value, &v, sizeof(T));
+    __atomic_store_n(&seq, s + 2, __ATOMIC_RELEASE);
+  }
+
+  /*!
+   *    @brief  Copy the value out once, without retrying
+   *    @param  out Where to copy the value
+   *    @return False if a write overlapped the copy; out is then garbage
+   */
+  bool tryRead(T *out) const {
+    uint32_t s1 = __atomic_load_n(&seq, __ATOMIC_ACQUIRE);
+    if (s1 & 1)
+      return false;
+    memcpy(out, &value, sizeof(T));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&seq, __ATOMIC_RELAXED) == s1;
+  }
+
+  /*!
+   *    @brief  Copy the value out, retrying until a consistent copy is made
+   *    @param  out Where to copy the value
+   */
+  void read(T *out) const {
+    while (!tryRead(out)) {
+    }
+  }
+
+  /*!
+   *    @brief  Number of completed writes
+   *    @return Count of write() calls that have finished
+   */
+  uint32_t writes(void) const {
+    return __atomic_load_n(&seq, __ATOMIC_ACQUIRE) / 2;
+  }
+};
+
+#endif
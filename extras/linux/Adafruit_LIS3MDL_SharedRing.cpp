@@ -0,0 +1,237 @@
+/*!
+ * @file     Adafruit_LIS3MDL_SharedRing.cpp
+ *
+ * POSIX shared-memory ring of LIS3MDL samples. The publisher is wait-free:
+ * it writes each slot under that slot's sequence lock and then bumps the
+ * head counter. Readers keep their own position, copy entries straight out
+ * of the mapping with no system calls, and detect being lapped by checking
+ * the stream index stored in each entry.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_LIS3MDL_SharedRing.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/*!
+ *    @brief  Create (or take over) a ring in /dev/shm
+ *    @param  name Shared memory object name, for example "/lis3mdl0"
+ *    @param  capacity Number of slots, a power of two
+ *    @return True if the ring is mapped and ready, false if the capacity is
+ *            not a power of two or the mapping failed
+ */
+bool Adafruit_LIS3MDL_RingPublisher::begin(const char *name,
+                                           uint32_t capacity) {
+  end();
+
+  if (capacity == 0 || (capacity & (capacity - 1)))
+    return false;
+
+  int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+  if (fd < 0)
+    return false;
+  _size = sizeof(lis3mdl_ring_header_t) +
+          (size_t)capacity * sizeof(lis3mdl_ring_slot_t);
+  if (ftruncate(fd, _size) < 0) {
+    close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  snprintf(_name, sizeof(_name), "%s", name);
+  _header = (lis3mdl_ring_header_t *)map;
+  _slots = (lis3mdl_ring_slot_t *)(_header + 1);
+  _capacity = capacity;
+
+  // Invalidate first so readers of a previous instance back off
+  __atomic_store_n(&_header->magic, 0, __ATOMIC_RELEASE);
+  memset(_slots, 0, (size_t)capacity * sizeof(lis3mdl_ring_slot_t));
+  _header->version = LIS3MDL_RING_VERSION;
+  _header->capacity = capacity;
+  _header->slotSize = sizeof(lis3mdl_ring_slot_t);
+  __atomic_store_n(&_header->head, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&_header->magic, LIS3MDL_RING_MAGIC, __ATOMIC_RELEASE);
+  return true;
+}
+
+/*!
+ *    @brief  Unmap and remove the ring. Readers keep their mapping until
+ *            they call end() themselves.
+ */
+void Adafruit_LIS3MDL_RingPublisher::end(void) {
+  if (!_header)
+    return;
+  __atomic_store_n(&_header->magic, 0, __ATOMIC_RELEASE);
+  munmap(_header, _size);
+  shm_unlink(_name);
+  _header = NULL;
+  _slots = NULL;
+}
+
+Adafruit_LIS3MDL_RingPublisher::~Adafruit_LIS3MDL_RingPublisher(void) {
+  end();
+}
+
+/*!
+ *    @brief  Append a sample to the ring, never blocking
+ *    @param  sample The reading to publish
+ *    @param  range The range it was taken at, so readers can scale it
+ */
+void Adafruit_LIS3MDL_RingPublisher::publish(const lis3mdl_sample_t *sample,
+                                             lis3mdl_range_t range) {
+  if (!_header)
+    return;
+
+  lis3mdl_ring_entry_t entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.index = __atomic_load_n(&_header->head, __ATOMIC_RELAXED);
+  entry.sample = *sample;
+  entry.range = range;
+
+  _slots[entry.index & (_capacity - 1)].write(entry);
+  __atomic_store_n(&_header->head, entry.index + 1, __ATOMIC_RELEASE);
+}
+
+/*!
+ *    @brief  Read the sensor once and publish the sample if it is new
+ *    @param  sensor The sensor this process owns
+ *    @return True if a new sample was published
+ */
+bool Adafruit_LIS3MDL_RingPublisher::acquire(Adafruit_LIS3MDL *sensor) {
+  lis3mdl_sample_t sample;
+  if (!sensor->readSample(&sample) || !(sample.status & 0x08))
+    return false;
+  publish(&sample, sensor->rangeBuffered);
+  return true;
+}
+
+/*!
+ *    @brief  Map an existing ring read-only
+ *    @param  name Shared memory object name used by the publisher
+ *    @param  fromStart If true, start with the oldest entry still in the
+ *            ring; otherwise only entries published from now on are read
+ *    @return True if a valid ring was found
+ */
+bool Adafruit_LIS3MDL_RingReader::begin(const char *name, bool fromStart) {
+  end();
+
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+  off_t size = lseek(fd, 0, SEEK_END);
+  if (size < (off_t)sizeof(lis3mdl_ring_header_t)) {
+    close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  _header = (const lis3mdl_ring_header_t *)map;
+  _slots = (const lis3mdl_ring_slot_t *)(_header + 1);
+  _size = size;
+
+  // Read the capacity once; the mapping is shared, so only this copy is used
+  bool valid = __atomic_load_n(&_header->magic, __ATOMIC_ACQUIRE) ==
+               LIS3MDL_RING_MAGIC;
+  _capacity = __atomic_load_n(&_header->capacity, __ATOMIC_RELAXED);
+  if (!valid || _header->version != LIS3MDL_RING_VERSION ||
+      _header->slotSize != sizeof(lis3mdl_ring_slot_t) || _capacity == 0 ||
+      (_capacity & (_capacity - 1)) ||
+      sizeof(lis3mdl_ring_header_t) +
+              (size_t)_capacity * sizeof(lis3mdl_ring_slot_t) >
+          _size) {
+    end();
+    return false;
+  }
+
+  uint64_t head = __atomic_load_n(&_header->head, __ATOMIC_ACQUIRE);
+  _next = head;
+  if (fromStart)
+    _next = head > _capacity ? head - _capacity : 0;
+  _dropped = 0;
+  return true;
+}
+
+/*!
+ *    @brief  Unmap the ring
+ */
+void Adafruit_LIS3MDL_RingReader::end(void) {
+  if (_header)
+    munmap((void *)_header, _size);
+  _header = NULL;
+  _slots = NULL;
+  _capacity = 0;
+}
+
+Adafruit_LIS3MDL_RingReader::~Adafruit_LIS3MDL_RingReader(void) { end(); }
+
+/*!
+ *    @brief  Copy out entries this reader has not seen yet, oldest first. If
+ *            the publisher lapped this reader, the skipped entries are
+ *            counted in dropped().
+ *    @param  entries Where to store the entries
+ *    @param  count Maximum number of entries to copy
+ *    @return Number of entries copied
+ */
+size_t Adafruit_LIS3MDL_RingReader::read(lis3mdl_ring_entry_t *entries,
+                                         size_t count) {
+  size_t n = 0;
+
+  if (!_header)
+    return 0;
+
+  uint32_t capacity = _capacity;
+  while (n < count) {
+    uint64_t head = __atomic_load_n(&_header->head, __ATOMIC_ACQUIRE);
+    if (head < _next)
+      _next = head; // publisher restarted
+    if (_next == head)
+      break;
+    if (head - _next > capacity) {
+      _dropped += head - capacity - _next;
+      _next = head - capacity;
+    }
+
+    lis3mdl_ring_entry_t entry;
+    if (!_slots[_next & (capacity - 1)].tryRead(&entry))
+      continue; // slot is being overwritten, head will have moved on
+    if (entry.index < _next)
+      break; // stale slot from a restarted publisher
+    if (entry.index != _next)
+      continue; // lapped while copying
+
+    entries[n++] = entry;
+    _next++;
+  }
+  return n;
+}
+
+/*!
+ *    @brief  Copy out the most recent entry without consuming anything
+ *    @param  entry Where to store the entry
+ *    @return False if nothing has been published yet
+ */
+bool Adafruit_LIS3MDL_RingReader::latest(lis3mdl_ring_entry_t *entry) {
+  if (!_header)
+    return false;
+
+  while (true) {
+    uint64_t head = __atomic_load_n(&_header->head, __ATOMIC_ACQUIRE);
+    if (head == 0)
+      return false;
+    const lis3mdl_ring_slot_t *slot =
+        &_slots[(head - 1) & (_capacity - 1)];
+    if (slot->tryRead(entry) && entry->index == head - 1)
+      return true;
+  }
+}
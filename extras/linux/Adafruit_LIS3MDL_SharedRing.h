@@ -0,0 +1,82 @@
+/*!
+ * @file     Adafruit_LIS3MDL_SharedRing.h
+ *
+ * Shared-memory sample ring for fanning one LIS3MDL stream out to many
+ * processes on Linux. One publisher owns the bus and writes samples; any
+ * number of readers map the same ring and never touch the bus.
+ *
+ */
+
+#ifndef ADAFRUIT_LIS3MDL_SHAREDRING_H
+#define ADAFRUIT_LIS3MDL_SHAREDRING_H
+
+#include "Adafruit_LIS3MDL_Seqlock.h"
+#include <Adafruit_LIS3MDL.h>
+
+#define LIS3MDL_RING_MAGIC 0x524D334C ///< "L3MR"
+#define LIS3MDL_RING_VERSION 1        ///< Layout version
+
+/** One published sample */
+typedef struct {
+  uint64_t index;          ///< Position in the stream, from 0
+  lis3mdl_sample_t sample; ///< The reading
+  uint8_t range;           ///< lis3mdl_range_t when it was taken
+} lis3mdl_ring_entry_t;
+
+/** One ring slot, an entry guarded by its own sequence lock */
+typedef Adafruit_LIS3MDL_Seqlock<lis3mdl_ring_entry_t> lis3mdl_ring_slot_t;
+
+/** Start of the shared memory block, followed by the slots */
+typedef struct {
+  uint32_t magic;    ///< LIS3MDL_RING_MAGIC once initialized
+  uint32_t version;  ///< LIS3MDL_RING_VERSION
+  uint32_t capacity; ///< Number of slots, a power of two
+  uint32_t slotSize; ///< sizeof(lis3mdl_ring_slot_t)
+  uint64_t head;     ///< Number of entries published so far
+  uint8_t pad[40];   ///< Keeps the slots on their own cache line
+} lis3mdl_ring_header_t;
+
+/** Creates the ring and publishes samples into it */
+class Adafruit_LIS3MDL_RingPublisher {
+public:
+  ~Adafruit_LIS3MDL_RingPublisher(void);
+
+  bool begin(const char *name, uint32_t capacity = 1024);
+  void end(void);
+  void publish(const lis3mdl_sample_t *sample, lis3mdl_range_t range);
+  bool acquire(Adafruit_LIS3MDL *sensor);
+
+private:
+  lis3mdl_ring_header_t *_header = NULL;
+  lis3mdl_ring_slot_t *_slots = NULL;
+  uint32_t _capacity = 0; // slot count, kept out of the shared mapping
+  size_t _size = 0;
+  char _name[64];
+};
+
+/** Maps an existing ring and reads from it without touching the bus */
+class Adafruit_LIS3MDL_RingReader {
+public:
+  ~Adafruit_LIS3MDL_RingReader(void);
+
+  bool begin(const char *name, bool fromStart = false);
+  void end(void);
+  size_t read(lis3mdl_ring_entry_t *entries, size_t count);
+  bool latest(lis3mdl_ring_entry_t *entry);
+
+  /*!
+   *    @brief  Entries the publisher overwrote before this reader got to them
+   *    @return Count since begin()
+   */
+  uint64_t dropped(void) { return _dropped; }
+
+private:
+  const lis3mdl_ring_header_t *_header = NULL;
+  const lis3mdl_ring_slot_t *_slots = NULL;
+  uint32_t _capacity = 0; // slot count checked by begin(), never re-read
+  size_t _size = 0;
+  uint64_t _next = 0;
+  uint64_t _dropped = 0;
+};
+
+#endif
@@ -0,0 +1,172 @@
+/*!
+ * @file     Adafruit_SPIDevice.cpp
+ *
+ * spidev backed SPI device for the Linux port. Address and data phases are
+ * separate transfers inside one SPI_IOC_MESSAGE, so chip select stays low
+ * for the whole register access and it costs a single ioctl.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Adafruit_SPIDevice.h"
+#include "lis3mdl_linux_io.h"
+
+#include <fcntl.h>
+#include <linux/spi/spidev.h>
+#include <stdio.h>
+
+/*!
+ *    @brief  Create a hardware SPI device
+ *    @param  cspin Chip select, the C in /dev/spidevB.C
+ *    @param  freq Clock frequency in Hz
+ *    @param  dataOrder Bit order
+ *    @param  dataMode SPI mode, SPI_MODE0 to SPI_MODE3
+ *    @param  theSPI The bus, the B in /dev/spidevB.C
+ */
+Adafruit_SPIDevice::Adafruit_SPIDevice(int8_t cspin, uint32_t freq,
+                                       BusIOBitOrder dataOrder,
+                                       uint8_t dataMode, SPIClass *theSPI)
+    : _cs(cspin), _freq(freq), _dataOrder(dataOrder), _dataMode(dataMode),
+      _spi(theSPI) {}
+
+/*!
+ *    @brief  Software SPI is not available on Linux, begin() will fail
+ *    @param  cspin Ignored
+ *    @param  sckpin Ignored
+ *    @param  misopin Ignored
+ *    @param  mosipin Ignored
+ *    @param  freq Ignored
+ *    @param  dataOrder Ignored
+ *    @param  dataMode Ignored
+ */
+Adafruit_SPIDevice::Adafruit_SPIDevice(int8_t cspin, int8_t sckpin,
+                                       int8_t misopin, int8_t mosipin,
+                                       uint32_t freq, BusIOBitOrder dataOrder,
+                                       uint8_t dataMode)
+    : _cs(cspin), _freq(freq), _dataOrder(dataOrder), _dataMode(dataMode),
+      _spi(NULL) {
+  (void)sckpin, (void)misopin, (void)mosipin;
+}
+
+Adafruit_SPIDevice::~Adafruit_SPIDevice(void) {
+  if (_fd >= 0)
+    lis3mdl_linux_io()->close(_fd);
+}
+
+/*!
+ *    @brief  Open the spidev node and set mode, bit order and clock
+ *    @return True if the node opened and accepted the settings
+ */
+bool Adafruit_SPIDevice::begin(void) {
+  if (_fd >= 0)
+    return true;
+  if (!_spi || _cs < 0)
+    return false;
+
+  char path[32];
+  snprintf(path, sizeof(path), "/dev/spidev%u.%u", _spi->bus(), _cs);
+
+  const lis3mdl_linux_io_t *io = lis3mdl_linux_io();
+  _fd = io->open(path, O_RDWR);
+  if (_fd < 0)
+    return false;
+
+  uint8_t mode = _dataMode;
+  uint8_t lsb = (_dataOrder == SPI_BITORDER_LSBFIRST);
+  uint8_t bits = 8;
+  if (io->ioctl(_fd, SPI_IOC_WR_MODE, &mode) < 0 ||
+      io->ioctl(_fd, SPI_IOC_WR_LSB_FIRST, &lsb) < 0 ||
+      io->ioctl(_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0 ||
+      io->ioctl(_fd, SPI_IOC_WR_MAX_SPEED_HZ, &_freq) < 0) {
+    io->close(_fd);
+    _fd = -1;
+    return false;
+  }
+  return true;
+}
+
+bool Adafruit_SPIDevice::message(void *xfers, uint8_t count) {
+  if (_fd < 0)
+    return false;
+  _transfers++;
+  return lis3mdl_linux_io()->ioctl(_fd, SPI_IOC_MESSAGE(count), xfers) >= 0;
+}
+
+/*!
+ *    @brief  Read from the device with chip select held low
+ *    @param  buffer Where to store the data
+ *    @param  len Number of bytes to read
+ *    @param  sendvalue Byte clocked out while reading
+ *    @return True on success
+ */
+bool Adafruit_SPIDevice::read(uint8_t *buffer, size_t len, uint8_t sendvalue) {
+  memset(buffer, sendvalue, len);
+
+  struct spi_ioc_transfer xfer;
+  memset(&xfer, 0, sizeof(xfer));
+  xfer.tx_buf = (unsigned long)buffer;
+  xfer.rx_buf = (unsigned long)buffer;
+  xfer.len = len;
+  xfer.speed_hz = _freq;
+  return message(&xfer, 1);
+}
+
+/*!
+ *    @brief  Write to the device with chip select held low throughout
+ *    @param  buffer Data to write
+ *    @param  len Number of bytes to write
+ *    @param  prefix_buffer Optional bytes sent first, usually the register
+ *    @param  prefix_len Number of prefix bytes
+ *    @return True on success
+ */
+bool Adafruit_SPIDevice::write(const uint8_t *buffer, size_t len,
+                               const uint8_t *prefix_buffer,
+                               size_t prefix_len) {
+  struct spi_ioc_transfer xfers[2];
+  uint8_t count = 0;
+
+  memset(xfers, 0, sizeof(xfers));
+  if (prefix_len) {
+    xfers[count].tx_buf = (unsigned long)prefix_buffer;
+    xfers[count].len = prefix_len;
+    xfers[count].speed_hz = _freq;
+    count++;
+  }
+  if (len) {
+    xfers[count].tx_buf = (unsigned long)buffer;
+    xfers[count].len = len;
+    xfers[count].speed_hz = _freq;
+    count++;
+  }
+  if (count == 0)
+    return true;
+  return message(xfers, count);
+}
+
+/*!
+ *    @brief  Write then read with chip select held low, in a single ioctl
+ *    @param  write_buffer Data to write, usually the register address
+ *    @param  write_len Number of bytes to write
+ *    @param  read_buffer Where to store the data read back
+ *    @param  read_len Number of bytes to read
+ *    @param  sendvalue Byte clocked out while reading
+ *    @return True on success
+ */
+bool Adafruit_SPIDevice::write_then_read(const uint8_t *write_buffer,
+                                         size_t write_len, uint8_t *read_buffer,
+                                         size_t read_len, uint8_t sendvalue) {
+  struct spi_ioc_transfer xfers[2];
+
+  // Clock out sendvalue during the data phase by reading in place
+  memset(read_buffer, sendvalue, read_len);
+  memset(xfers, 0, sizeof(xfers));
+  xfers[0].tx_buf = (unsigned long)write_buffer;
+  xfers[0].len = write_len;
+  xfers[0].speed_hz = _freq;
+  xfers[1].tx_buf = (unsigned long)read_buffer;
+  xfers[1].rx_buf = (unsigned long)read_buffer;
+  xfers[1].len = read_len;
+  xfers[1].speed_hz = _freq;
+  return message(xfers, 2);
+}
@@ -0,0 +1,74 @@
+/*!
+ * @file     Adafruit_SPIDevice.h
+ *
+ * Linux implementation of the Adafruit BusIO SPI device interface, on top of
+ * spidev. Only hardware SPI is supported; the chip select argument picks the
+ * spidev node.
+ *
+ */
+
+#ifndef LIS3MDL_LINUX_SPIDEVICE_H
+#define LIS3MDL_LINUX_SPIDEVICE_H
+
+#include "SPI.h"
+
+/** Bit order for SPI transfers */
+typedef enum _BitOrder {
+  SPI_BITORDER_MSBFIRST = MSBFIRST, ///< Most significant bit first
+  SPI_BITORDER_LSBFIRST = LSBFIRST, ///< Least significant bit first
+} BusIOBitOrder;
+
+/** Largest single SPI write, including the register address prefix */
+#define LIS3MDL_LINUX_SPI_MAX_WRITE 64
+
+/** An SPI device on a Linux spidev node */
+class Adafruit_SPIDevice {
+public:
+  Adafruit_SPIDevice(int8_t cspin, uint32_t freq = 1000000,
+                     BusIOBitOrder dataOrder = SPI_BITORDER_MSBFIRST,
+                     uint8_t dataMode = SPI_MODE0, SPIClass *theSPI = &SPI);
+  Adafruit_SPIDevice(int8_t cspin, int8_t sckpin, int8_t misopin,
+                     int8_t mosipin, uint32_t freq = 1000000,
+                     BusIOBitOrder dataOrder = SPI_BITORDER_MSBFIRST,
+                     uint8_t dataMode = SPI_MODE0);
+  ~Adafruit_SPIDevice(void);
+
+  bool begin(void);
+  bool read(uint8_t *buffer, size_t len, uint8_t sendvalue = 0xFF);
+  bool write(const uint8_t *buffer, size_t len,
+             const uint8_t *prefix_buffer = NULL, size_t prefix_len = 0);
+  bool write_then_read(const uint8_t *write_buffer, size_t write_len,
+                       uint8_t *read_buffer, size_t read_len,
+                       uint8_t sendvalue = 0xFF);
+
+  /*!
+   *    @brief  The open spidev file descriptor
+   *    @return Descriptor, or -1 before begin()
+   */
+  int fd(void) { return _fd; }
+
+  /*!
+   *    @brief  The SPI clock used for every transfer
+   *    @return Frequency in Hz
+   */
+  uint32_t frequency(void) { return _freq; }
+
+  /*!
+   *    @brief  Number of SPI_IOC_MESSAGE ioctls issued, for profiling
+   *    @return Count since the device was created
+   */
+  uint32_t transfers(void) { return _transfers; }
+
+private:
+  bool message(void *xfers, uint8_t count);
+
+  int8_t _cs;
+  uint32_t _freq;
+  BusIOBitOrder _dataOrder;
+  uint8_t _dataMode;
+  SPIClass *_spi;
+  int _fd = -1;
+  uint32_t _transfers = 0;
+};
+
+#endif
@@ -0,0 +1,83 @@
+/*!
+ * @file     Adafruit_Sensor.h
+ *
+ * The parts of the Adafruit Unified Sensor interface used by the LIS3MDL
+ * driver, with the same struct layouts, for the Linux port.
+ *
+ */
+
+#ifndef LIS3MDL_LINUX_SENSOR_H
+#define LIS3MDL_LINUX_SENSOR_H
+
+#include "Arduino.h"
+
+/** Sensor types, only the magnetometer is needed here */
+typedef enum {
+  SENSOR_TYPE_MAGNETIC_FIELD = (2), ///< Magnetic field in uTesla
+} sensors_type_t;
+
+/** A three axis reading */
+typedef struct {
+  union {
+    float v[3]; ///< The axes as an array
+    struct {
+      float x; ///< X component
+      float y; ///< Y component
+      float z; ///< Z component
+    };
+  };
+  int8_t status;       ///< Status byte
+  uint8_t reserved[3]; ///< Padding
+} sensors_vec_t;
+
+/** A sensor reading */
+typedef struct {
+  int32_t version;   ///< Must be sizeof(sensors_event_t)
+  int32_t sensor_id; ///< Unique sensor identifier
+  int32_t type;      ///< sensors_type_t
+  int32_t reserved0; ///< Reserved
+  int32_t timestamp; ///< Time in milliseconds
+  union {
+    float data[4];          ///< Raw data
+    sensors_vec_t magnetic; ///< Magnetic field in uTesla
+  };
+} sensors_event_t;
+
+/** Sensor details */
+typedef struct {
+  char name[12];     ///< Sensor name
+  int32_t version;   ///< Driver version
+  int32_t sensor_id; ///< Unique sensor identifier
+  int32_t type;      ///< sensors_type_t
+  float max_value;   ///< Maximum value in SI units
+  float min_value;   ///< Minimum value in SI units
+  float resolution;  ///< Smallest difference between two values
+  int32_t min_delay; ///< Minimum delay between events in us
+} sensor_t;
+
+/** Common interface for Unified Sensor drivers */
+class Adafruit_Sensor {
+public:
+  virtual ~Adafruit_Sensor() {}
+
+  /*!
+   *    @brief  Turn auto-ranging on or off, not supported by default
+   *    @param  enabled Ignored
+   */
+  virtual void enableAutoRange(bool enabled) { (void)enabled; }
+
+  /*!
+   *    @brief  Get the latest sensor event
+   *    @param  event Event to fill in
+   *    @return True on success
+   */
+  virtual bool getEvent(sensors_event_t *event) = 0;
+
+  /*!
+   *    @brief  Get information on the sensor
+   *    @param  sensor Details to fill in
+   */
+  virtual void getSensor(sensor_t *sensor) = 0;
+};
+
+#endif
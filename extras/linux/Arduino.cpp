@@ -0,0 +1,55 @@
+/*!
+ * @file     Arduino.cpp
+ *
+ * Linux timing functions behind the Arduino compatibility header. Both
+ * clocks count from the first call, on CLOCK_MONOTONIC.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Arduino.h"
+
+#include <time.h>
+
+static uint64_t lis3mdl_monotonic_raw_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static uint64_t lis3mdl_monotonic_us(void) {
+  // C++11 runs this once even when threads race to the first call
+  static const uint64_t start = lis3mdl_monotonic_raw_us();
+  return lis3mdl_monotonic_raw_us() - start;
+}
+
+/*!
+ *    @brief  Sleep for a number of milliseconds
+ *    @param  ms Time to sleep
+ */
+void delay(uint32_t ms) { delayMicroseconds(ms * 1000); }
+
+/*!
+ *    @brief  Sleep for a number of microseconds
+ *    @param  us Time to sleep
+ */
+void delayMicroseconds(uint32_t us) {
+  struct timespec ts;
+  ts.tv_sec = us / 1000000;
+  ts.tv_nsec = (long)(us % 1000000) * 1000;
+  while (nanosleep(&ts, &ts) != 0) {
+  }
+}
+
+/*!
+ *    @brief  Milliseconds since the first timing call
+ *    @return Time in ms, wrapping like the Arduino core
+ */
+uint32_t millis(void) { return (uint32_t)(lis3mdl_monotonic_us() / 1000); }
+
+/*!
+ *    @brief  Microseconds since the first timing call
+ *    @return Time in us, wrapping like the Arduino core
+ */
+uint32_t micros(void) { return (uint32_t)lis3mdl_monotonic_us(); }
@@ -0,0 +1,34 @@
+/*!
+ * @file     Arduino.h
+ *
+ * The handful of Arduino core definitions the LIS3MDL driver uses, so it can
+ * be compiled unmodified on Linux. Put this directory ahead of any Arduino
+ * core on the include path.
+ *
+ */
+
+#ifndef LIS3MDL_LINUX_ARDUINO_H
+#define LIS3MDL_LINUX_ARDUINO_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef bool boolean; ///< Arduino's name for bool
+typedef uint8_t byte; ///< Arduino's name for uint8_t
+
+#define LSBFIRST 0 ///< Least significant bit first
+#define MSBFIRST 1 ///< Most significant bit first
+
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+uint32_t millis(void);
+uint32_t micros(void);
+/*!
+ *    @brief  Nothing to yield to on Linux
+ */
+inline void yield(void) {}
+
+#endif
@@ -0,0 +1,12 @@
+/*!
+ * @file     SPI.cpp
+ *
+ * Default spidev bus for the Linux port
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "SPI.h"
+
+SPIClass SPI(0); ///< Default bus, /dev/spidev0.*
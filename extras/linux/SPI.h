@@ -0,0 +1,41 @@
+/*!
+ * @file     SPI.h
+ *
+ * Linux stand-in for the Arduino SPIClass. An SPIClass names a spidev bus
+ * number; the chip select picks the node, so bus 0 with chip select 1 is
+ * /dev/spidev0.1.
+ *
+ */
+
+#ifndef LIS3MDL_LINUX_SPI_H
+#define LIS3MDL_LINUX_SPI_H
+
+#include "Arduino.h"
+
+#define SPI_MODE0 0 ///< CPOL = 0, CPHA = 0
+#define SPI_MODE1 1 ///< CPOL = 0, CPHA = 1
+#define SPI_MODE2 2 ///< CPOL = 1, CPHA = 0
+#define SPI_MODE3 3 ///< CPOL = 1, CPHA = 1
+
+/** A spidev bus */
+class SPIClass {
+public:
+  /*!
+   *    @brief  Create a bus object
+   *    @param  bus The spidev bus number
+   */
+  SPIClass(uint8_t bus) : _bus(bus) {}
+
+  /*!
+   *    @brief  The spidev bus number
+   *    @return Bus number, the B in /dev/spidevB.C
+   */
+  uint8_t bus(void) { return _bus; }
+
+private:
+  uint8_t _bus;
+};
+
+extern SPIClass SPI;
+
+#endif
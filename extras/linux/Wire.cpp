@@ -0,0 +1,71 @@
+/*!
+ * @file     Wire.cpp
+ *
+ * i2c-dev bus access for the Linux port. Every transaction is a single
+ * I2C_RDWR ioctl, so a register address write followed by a read goes out
+ * with a repeated start in one kernel call.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "Wire.h"
+#include "lis3mdl_linux_io.h"
+
+#include <fcntl.h>
+#include <linux/i2c-dev.h>
+#include <linux/i2c.h>
+
+TwoWire Wire("/dev/i2c-1"); ///< Default bus, as on a Raspberry Pi
+
+/*!
+ *    @brief  Create a bus object, the node is not opened until begin()
+ *    @param  device Path of the i2c-dev node, for example "/dev/i2c-1"
+ */
+TwoWire::TwoWire(const char *device) : _device(device) {}
+
+TwoWire::~TwoWire(void) { end(); }
+
+/*!
+ *    @brief  Open the bus node if it is not open yet
+ *    @return True if the bus is usable
+ */
+bool TwoWire::begin(void) {
+  if (_fd >= 0)
+    return true;
+  _fd = lis3mdl_linux_io()->open(_device, O_RDWR);
+  return _fd >= 0;
+}
+
+/*!
+ *    @brief  Close the bus node
+ */
+void TwoWire::end(void) {
+  if (_fd >= 0)
+    lis3mdl_linux_io()->close(_fd);
+  _fd = -1;
+}
+
+/*!
+ *    @brief  The bus clock is fixed by the kernel (device tree) on Linux, so
+ *            this does nothing. Kept for API compatibility.
+ *    @param  frequency Ignored
+ */
+void TwoWire::setClock(uint32_t frequency) { (void)frequency; }
+
+/*!
+ *    @brief  Run a combined transaction in one I2C_RDWR ioctl
+ *    @param  msgs Messages, each carrying its own slave address
+ *    @param  count Number of messages, at most I2C_RDWR_IOCTL_MAX_MSGS
+ *    @return True if the kernel completed every message
+ */
+bool TwoWire::transfer(struct i2c_msg *msgs, uint32_t count) {
+  if (!begin())
+    return false;
+
+  struct i2c_rdwr_ioctl_data data;
+  data.msgs = msgs;
+  data.nmsgs = count;
+  _transfers++;
+  return lis3mdl_linux_io()->ioctl(_fd, I2C_RDWR, &data) == (int)count;
+}
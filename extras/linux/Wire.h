@@ -0,0 +1,47 @@
+/*!
+ * @file     Wire.h
+ *
+ * Linux stand-in for the Arduino TwoWire class. A TwoWire names an i2c-dev
+ * bus node and owns its file descriptor; all devices on the bus share it.
+ *
+ */
+
+#ifndef LIS3MDL_LINUX_WIRE_H
+#define LIS3MDL_LINUX_WIRE_H
+
+#include "Arduino.h"
+
+struct i2c_msg;
+
+/** An i2c-dev adapter such as /dev/i2c-1 */
+class TwoWire {
+public:
+  TwoWire(const char *device);
+  ~TwoWire(void);
+
+  bool begin(void);
+  void end(void);
+  void setClock(uint32_t frequency);
+  bool transfer(struct i2c_msg *msgs, uint32_t count);
+
+  /*!
+   *    @brief  The device node this bus opens
+   *    @return Path such as "/dev/i2c-1"
+   */
+  const char *device(void) { return _device; }
+
+  /*!
+   *    @brief  Number of I2C_RDWR ioctls issued, for profiling
+   *    @return Count since the bus was created
+   */
+  uint32_t transfers(void) { return _transfers; }
+
+private:
+  const char *_device;
+  int _fd = -1;
+  uint32_t _transfers = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,73 @@
+/*!
+ * @file     array_benchmark.cpp
+ *
+ * Throughput of the Adafruit_LIS3MDL_Array per-frame path (load, calibrate,
+ * gradient) for 4 to 32 sensors, on synthetic data. Build from the library
+ * root like any other Linux program (see ../README.md), adding this file
+ * and optimization flags such as -O3 -march=native.
+ *
+ * The calibration kernel vectorizes at -O3. The gradient kernel is a set of
+ * float reductions, which compilers only vectorize when allowed to reorder
+ * them (-ffast-math or -fassociative-math).
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include <Adafruit_LIS3MDL_Array.h>
+#include <stdio.h>
+#include <time.h>
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void) {
+  static const uint8_t sizes[] = {4, 8, 16, 32};
+  static float field[32][3];
+  Adafruit_LIS3MDL_Array array;
+  lis3mdl_calibration_t cal;
+  float gradient[3][3];
+  volatile float sink = 0;
+
+  memset(&cal, 0, sizeof(cal));
+  cal.matrix[0][0] = 1.01f;
+  cal.matrix[1][1] = 0.99f;
+  cal.matrix[2][2] = 1.02f;
+  cal.matrix[0][1] = cal.matrix[1][0] = 0.005f;
+  cal.offset[0] = 0.1f;
+
+  printf("sensors  ns/frame  frames/s\n");
+  for (uint8_t s = 0; s < sizeof(sizes); s++) {
+    uint8_t n = sizes[s];
+    array.begin(n);
+    for (uint8_t i = 0; i < n; i++) {
+      // Sensors spread over a 2 x 2 x n/4 grid, 5 cm apart
+      array.setPosition(i, 0.05f * (i & 1), 0.05f * ((i >> 1) & 1),
+                        0.05f * (i >> 2));
+      array.setCalibration(i, &cal);
+      for (uint8_t a = 0; a < 3; a++)
+        field[i][a] = 0.2f + 0.01f * i + 0.1f * a;
+    }
+    array.setGeometry();
+
+    uint32_t frames = 0;
+    double start = seconds(), elapsed;
+    do {
+      for (uint32_t k = 0; k < 10000; k++) {
+        for (uint8_t i = 0; i < n; i++)
+          array.setField(i, field[i][0], field[i][1], field[i][2] + k * 1e-7f);
+        array.calibrate();
+        array.getGradient(gradient);
+        sink += gradient[2][2];
+      }
+      frames += 10000;
+      elapsed = seconds() - start;
+    } while (elapsed < 0.5);
+
+    printf("%7u  %8.1f  %8.0f\n", n, elapsed * 1e9 / frames, frames / elapsed);
+  }
+  return 0;
+}
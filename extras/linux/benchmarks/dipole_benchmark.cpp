@@ -0,0 +1,112 @@
+/*!
+ * @file     dipole_benchmark.cpp
+ *
+ * Tracks a synthetic magnet circling over planar arrays of 4 to 32 sensors
+ * with Adafruit_LIS3MDL_Dipole and reports update time and position error.
+ * Frames come straight from the dipole model plus Earth's field and
+ * Gaussian noise at the LIS3MDL's ultra-high performance noise level.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include <Adafruit_LIS3MDL_Dipole.h>
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+static double seconds(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// xorshift32 and Box-Muller, so runs are repeatable everywhere
+static uint32_t state = 1;
+static float gaussian(void) {
+  float u[2];
+  for (uint8_t i = 0; i < 2; i++) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    u[i] = (state + 1.0f) / 4294967296.0f;
+  }
+  return sqrt(-2 * log(u[0])) * cos(6.2831853f * u[1]);
+}
+
+int main(void) {
+  static const uint8_t sizes[] = {4, 8, 16, 32};
+  const uint32_t frames = 2000;
+  const uint8_t iterations = 4;
+  const float noise = 0.0032f; // gauss RMS
+  const float pitch = 0.02f;   // metres between sensors
+  Adafruit_LIS3MDL_Array array;
+  Adafruit_LIS3MDL_Dipole tracker;
+
+  printf("sensors  mean us  max us  mean mm  max mm\n");
+  for (uint8_t s = 0; s < sizeof(sizes); s++) {
+    uint8_t n = sizes[s], columns = n < 8 ? 2 : 4;
+    float cx = (columns - 1) * pitch / 2;
+    float cy = (n / columns - 1) * pitch / 2;
+
+    array.begin(n);
+    for (uint8_t i = 0; i < n; i++)
+      array.setPosition(i, (i % columns) * pitch - cx,
+                        (i / columns) * pitch - cy, 0);
+    array.setGeometry();
+
+    lis3mdl_dipole_t truth, estimate;
+    memset(&truth, 0, sizeof(truth));
+    truth.background[0] = 0.2f;
+    truth.background[1] = 0.05f;
+    truth.background[2] = -0.4f;
+    memset(&estimate, 0, sizeof(estimate));
+    estimate.position[2] = 0.04f;
+    estimate.moment[2] = 0.01f;
+    tracker.begin(&estimate, true, iterations);
+
+    double total = 0, worst = 0, errorSum = 0, errorMax = 0;
+    for (uint32_t f = 0; f < frames; f++) {
+      float angle = f * 0.01f;
+      truth.position[0] = 0.02f * cos(angle);
+      truth.position[1] = 0.02f * sin(angle);
+      truth.position[2] = 0.04f;
+      truth.moment[0] = 0.005f * cos(2 * angle);
+      truth.moment[1] = 0.005f * sin(2 * angle);
+      truth.moment[2] = 0.008f;
+
+      for (uint8_t i = 0; i < n; i++) {
+        float point[3], field[3];
+        array.getPosition(i, point);
+        lis3mdl_dipoleField(&truth, point, field);
+        array.setField(i, field[0] + noise * gaussian(),
+                       field[1] + noise * gaussian(),
+                       field[2] + noise * gaussian());
+      }
+
+      double start = seconds();
+      tracker.update(&array);
+      double elapsed = seconds() - start;
+
+      tracker.getState(&estimate);
+      float error = 0;
+      for (uint8_t a = 0; a < 3; a++)
+        error += (estimate.position[a] - truth.position[a]) *
+                 (estimate.position[a] - truth.position[a]);
+      error = sqrt(error) * 1000;
+
+      // Let the tracker lock on before scoring it
+      if (f < 100)
+        continue;
+      total += elapsed;
+      worst = elapsed > worst ? elapsed : worst;
+      errorSum += error;
+      errorMax = error > errorMax ? error : errorMax;
+    }
+
+    uint32_t scored = frames - 100;
+    printf("%7u  %7.2f  %6.2f  %7.3f  %6.3f\n", n, total * 1e6 / scored,
+           worst * 1e6, errorSum / scored, errorMax);
+  }
+  return 0;
+}
@@ -0,0 +1,53 @@
+/*!
+ * @file     lis3mdl_linux_io.cpp
+ *
+ * Default (libc) implementation of the Linux file descriptor layer
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include "lis3mdl_linux_io.h"
+
+#include <fcntl.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+static int lis3mdl_sys_open(const char *path, int flags) {
+  return ::open(path, flags);
+}
+
+static int lis3mdl_sys_close(int fd) { return ::close(fd); }
+
+static int lis3mdl_sys_ioctl(int fd, unsigned long request, void *arg) {
+  return ::ioctl(fd, request, arg);
+}
+
+static ssize_t lis3mdl_sys_read(int fd, void *buf, size_t count) {
+  return ::read(fd, buf, count);
+}
+
+static ssize_t lis3mdl_sys_write(int fd, const void *buf, size_t count) {
+  return ::write(fd, buf, count);
+}
+
+static const lis3mdl_linux_io_t lis3mdl_sys_io = {
+    lis3mdl_sys_open, lis3mdl_sys_close, lis3mdl_sys_ioctl, lis3mdl_sys_read,
+    lis3mdl_sys_write};
+
+static const lis3mdl_linux_io_t *lis3mdl_current_io = &lis3mdl_sys_io;
+
+/*!
+ *    @brief  Replace the system call table used by the Linux transports
+ *    @param  io The table to use, or NULL to restore the libc calls. The
+ *            table must stay valid until it is replaced.
+ */
+void lis3mdl_linux_setIO(const lis3mdl_linux_io_t *io) {
+  lis3mdl_current_io = io ? io : &lis3mdl_sys_io;
+}
+
+/*!
+ *    @brief  Get the system call table in use
+ *    @return The current table, never NULL
+ */
+const lis3mdl_linux_io_t *lis3mdl_linux_io(void) { return lis3mdl_current_io; }
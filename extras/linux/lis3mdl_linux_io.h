@@ -0,0 +1,28 @@
+/*!
+ * @file     lis3mdl_linux_io.h
+ *
+ * File descriptor layer used by the Linux transports. Every open(), close(),
+ * ioctl(), read() and write() made on behalf of the driver goes through this
+ * table, so a test harness can swap in a mock device without touching /dev.
+ *
+ */
+
+#ifndef LIS3MDL_LINUX_IO_H
+#define LIS3MDL_LINUX_IO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+/** System calls used by the Linux transports */
+typedef struct {
+  int (*open)(const char *path, int flags);                ///< open(2)
+  int (*close)(int fd);                                    ///< close(2)
+  int (*ioctl)(int fd, unsigned long request, void *arg);  ///< ioctl(2)
+  ssize_t (*read)(int fd, void *buf, size_t count);        ///< read(2)
+  ssize_t (*write)(int fd, const void *buf, size_t count); ///< write(2)
+} lis3mdl_linux_io_t;
+
+void lis3mdl_linux_setIO(const lis3mdl_linux_io_t *io);
+const lis3mdl_linux_io_t *lis3mdl_linux_io(void);
+
+#endif
@@ -0,0 +1,208 @@
+/*!
+ * @file     iio_test.cpp
+ *
+ * Runs Adafruit_LIS3MDL_IIO against a fake sysfs tree and buffer file made
+ * of plain files in a temporary directory, and checks the scan layout, the
+ * decoded axes, the scale and the timestamp conversion. Build from the
+ * library root like any other Linux program (see ../README.md); the
+ * program exits nonzero if a check fails.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include <Adafruit_LIS3MDL_IIO.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+static int failures = 0;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char *what, int line) {
+  if (!ok) {
+    printf("FAIL line %d: %s\n", line, what);
+    failures++;
+  }
+}
+
+static char root[64];
+
+static void put(const char *path, const void *data, size_t len) {
+  char full[256];
+  snprintf(full, sizeof(full), "%s/%s", root, path);
+  FILE *f = fopen(full, "wb");
+  if (!f) {
+    printf("cannot create %s\n", full);
+    exit(2);
+  }
+  fwrite(data, 1, len, f);
+  fclose(f);
+}
+
+static void putText(const char *path, const char *text) {
+  put(path, text, strlen(text));
+}
+
+static void makeDir(const char *path) {
+  char full[256];
+  snprintf(full, sizeof(full), "%s/%s", root, path);
+  mkdir(full, 0700);
+}
+
+static bool readText(const char *path, char *text, size_t len) {
+  char full[256];
+  snprintf(full, sizeof(full), "%s/%s", root, path);
+  FILE *f = fopen(full, "r");
+  if (!f)
+    return false;
+  size_t n = fread(text, 1, len - 1, f);
+  fclose(f);
+  text[n] = 0;
+  return true;
+}
+
+// One scan element of iio:device0
+static void putChannel(const char *name, int index, const char *type) {
+  char path[128], value[16];
+  snprintf(path, sizeof(path), "sys/iio:device0/scan_elements/%s_en", name);
+  putText(path, "0\n");
+  snprintf(path, sizeof(path), "sys/iio:device0/scan_elements/%s_index",
+           name);
+  snprintf(value, sizeof(value), "%d\n", index);
+  putText(path, value);
+  snprintf(path, sizeof(path), "sys/iio:device0/scan_elements/%s_type", name);
+  putText(path, type);
+}
+
+static void makeTree(void) {
+  makeDir("sys");
+  makeDir("sys/iio:device0");
+  makeDir("sys/iio:device0/scan_elements");
+  makeDir("sys/iio:device0/trigger");
+  makeDir("sys/iio:device0/buffer");
+  makeDir("dev");
+
+  putText("sys/iio:device0/name", "lis3mdl\n");
+  putText("sys/iio:device0/in_magn_scale", "0.000146\n");
+  putText("sys/iio:device0/in_magn_scale_available",
+          "0.000146 0.000292 0.000438 0.000584\n");
+  putText("sys/iio:device0/sampling_frequency", "80\n");
+  putText("sys/iio:device0/sampling_frequency_available",
+          "0.625 1.25 2.5 5 10 20 40 80 155 300 560 1000\n");
+  putText("sys/iio:device0/trigger/current_trigger", "\n");
+  putText("sys/iio:device0/buffer/length", "0\n");
+  putText("sys/iio:device0/buffer/enable", "0\n");
+
+  // Out of index order in sysfs; Y is big-endian and Z a 12-bit value
+  // stored left-justified, to exercise every field of the type string
+  putChannel("in_magn_z", 2, "le:s12/16>>4\n");
+  putChannel("in_magn_x", 0, "le:s16/16>>0\n");
+  putChannel("in_magn_y", 1, "be:s16/16>>0\n");
+  putChannel("in_timestamp", 3, "le:s64/64>>0\n");
+}
+
+// X, Y, Z, 2 bytes of padding, then the 8-byte aligned timestamp
+static void packRecord(uint8_t *r, int16_t x, int16_t y, int16_t z,
+                       int64_t ns) {
+  uint16_t zs = (uint16_t)(z << 4);
+  memset(r, 0xAA, 16); // padding must be ignored
+  r[0] = x & 0xFF;
+  r[1] = (uint16_t)x >> 8;
+  r[2] = (uint16_t)y >> 8;
+  r[3] = y & 0xFF;
+  r[4] = zs & 0xFF;
+  r[5] = zs >> 8;
+  for (int i = 0; i < 8; i++)
+    r[8 + i] = (uint64_t)ns >> (8 * i);
+}
+
+static void testCapture(void) {
+  char sys[128], dev[128], value[32];
+  snprintf(sys, sizeof(sys), "%s/sys", root);
+  snprintf(dev, sizeof(dev), "%s/dev", root);
+
+  static const int16_t xs[3] = {1000, -32768, 0};
+  static const int16_t ys[3] = {-2000, 32767, -1};
+  static const int16_t zs[3] = {2047, -2048, -1};
+  static const int64_t ns[3] = {123456789LL, 5000000999999LL, 999999LL};
+  uint8_t buffer[3 * 16];
+  for (int i = 0; i < 3; i++)
+    packRecord(buffer + 16 * i, xs[i], ys[i], zs[i], ns[i]);
+  put("dev/iio:device0", buffer, sizeof(buffer));
+
+  Adafruit_LIS3MDL_IIO iio(sys, dev);
+  CHECK(iio.begin("lis3mdl"));
+  CHECK(fabsf(iio.gaussPerLSB() - 0.000146f) < 1e-9f);
+  CHECK(iio.getRange() == LIS3MDL_RANGE_4_GAUSS);
+  CHECK(iio.getDataRate() == LIS3MDL_DATARATE_80_HZ);
+
+  CHECK(iio.setRange(LIS3MDL_RANGE_8_GAUSS));
+  CHECK(readText("sys/iio:device0/in_magn_scale", value, sizeof(value)));
+  CHECK(strcmp(value, "0.000292") == 0);
+  CHECK(fabsf(iio.gaussPerLSB() - 0.000292f) < 1e-9f);
+
+  CHECK(iio.startCapture());
+  CHECK(iio.recordSize() == 16);
+  CHECK(readText("sys/iio:device0/scan_elements/in_magn_x_en", value,
+                 sizeof(value)));
+  CHECK(strcmp(value, "1") == 0);
+  CHECK(readText("sys/iio:device0/trigger/current_trigger", value,
+                 sizeof(value)));
+  CHECK(strcmp(value, "lis3mdl-trigger") == 0);
+  CHECK(readText("sys/iio:device0/buffer/enable", value, sizeof(value)));
+  CHECK(strcmp(value, "1") == 0);
+
+  lis3mdl_sample_t samples[4];
+  CHECK(iio.readSamples(samples, 4) == 3);
+  for (int i = 0; i < 3; i++) {
+    CHECK(samples[i].x == xs[i]);
+    CHECK(samples[i].y == ys[i]);
+    CHECK(samples[i].z == zs[i]);
+    CHECK(samples[i].status == 0x08);
+    CHECK(samples[i].timestamp == (uint32_t)(ns[i] / 1000000));
+  }
+  CHECK(samples[0].timestamp == 123);
+  CHECK(samples[1].timestamp == 5000000);
+  CHECK(samples[2].timestamp == 0);
+  CHECK(samples[1].flags & LIS3MDL_FLAG_SATURATED);
+  CHECK(!(samples[0].flags & LIS3MDL_FLAG_SATURATED));
+  iio.stopCapture();
+}
+
+// Type strings that cannot describe a channel are refused
+static void testBadTypes(void) {
+  static const char *bad[] = {"le:s0/16>>0\n", "le:s16/16>>4\n",
+                              "le:s16/12>>0\n", "le:s64/128>>0\n"};
+  char sys[128], dev[128];
+  snprintf(sys, sizeof(sys), "%s/sys", root);
+  snprintf(dev, sizeof(dev), "%s/dev", root);
+
+  for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); i++) {
+    putChannel("in_magn_x", 0, bad[i]);
+    Adafruit_LIS3MDL_IIO iio(sys, dev);
+    CHECK(iio.begin("lis3mdl"));
+    CHECK(!iio.startCapture());
+  }
+}
+
+int main(void) {
+  char cmd[96];
+
+  snprintf(root, sizeof(root), "/tmp/lis3mdl_iio_XXXXXX");
+  if (!mkdtemp(root)) {
+    printf("cannot create a temporary directory\n");
+    return 2;
+  }
+  makeTree();
+
+  testCapture();
+  testBadTypes();
+
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+  if (system(cmd) != 0)
+    printf("could not remove %s\n", root);
+  printf("%s\n", failures ? "FAILED" : "OK");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+/*!
+ * @file     settling_test.cpp
+ *
+ * Checks which samples Adafruit_LIS3MDL flags with LIS3MDL_FLAG_SETTLING,
+ * on the scene emulator: none in a trigger-then-read single-shot loop, and
+ * the next LIS3MDL_SETTLE_SAMPLES fresh samples after a settings change,
+ * whether it went through a setter, reset(), runSelfTest() or the raw
+ * register restore of the production test. Build from the library root
+ * like any other Linux program (see ../README.md); the program exits
+ * nonzero if a check fails.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include <Adafruit_LIS3MDL_Production.h>
+#include <Adafruit_LIS3MDL_SceneIO.h>
+#include <stdio.h>
+
+static int failures = 0;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char *what, int line) {
+  if (!ok) {
+    printf("FAIL line %d: %s\n", line, what);
+    failures++;
+  }
+}
+
+// Wait for and read the next fresh sample
+static bool freshSample(Adafruit_LIS3MDL *lis3mdl, lis3mdl_sample_t *sample) {
+  uint32_t start = millis();
+  while (millis() - start < 500) {
+    if (!lis3mdl->readSample(sample))
+      return false;
+    if (!(sample->flags & LIS3MDL_FLAG_STALE))
+      return true;
+    delayMicroseconds(200);
+  }
+  return false;
+}
+
+// The next LIS3MDL_SETTLE_SAMPLES fresh samples settle, the one after not
+static void checkSettles(Adafruit_LIS3MDL *lis3mdl, int line) {
+  lis3mdl_sample_t sample;
+
+  for (uint8_t i = 0; i <= LIS3MDL_SETTLE_SAMPLES; i++) {
+    bool settling = i < LIS3MDL_SETTLE_SAMPLES;
+    bool ok = freshSample(lis3mdl, &sample) &&
+              !!(sample.flags & LIS3MDL_FLAG_SETTLING) == settling;
+    if (!ok) {
+      printf("FAIL line %d: fresh sample %u, flags 0x%02X\n", line, i,
+             sample.flags);
+      failures++;
+    }
+  }
+}
+
+static void testSingleShot(Adafruit_LIS3MDL *lis3mdl) {
+  lis3mdl_sample_t sample;
+
+  lis3mdl->setOperationMode(LIS3MDL_POWERDOWNMODE);
+  for (uint8_t i = 0; i < 8; i++) {
+    lis3mdl->setOperationMode(LIS3MDL_SINGLEMODE);
+    CHECK(freshSample(lis3mdl, &sample));
+    CHECK(!(sample.flags & LIS3MDL_FLAG_SETTLING));
+  }
+
+  // A range change still flags the single-shot samples that follow it
+  lis3mdl->setRange(LIS3MDL_RANGE_8_GAUSS);
+  for (uint8_t i = 0; i <= LIS3MDL_SETTLE_SAMPLES; i++) {
+    lis3mdl->setOperationMode(LIS3MDL_SINGLEMODE);
+    CHECK(freshSample(lis3mdl, &sample));
+    CHECK(!!(sample.flags & LIS3MDL_FLAG_SETTLING) ==
+          (i < LIS3MDL_SETTLE_SAMPLES));
+  }
+}
+
+int main(void) {
+  Adafruit_LIS3MDL_Scene scene(11);
+  Adafruit_LIS3MDL lis3mdl;
+  lis3mdl_sample_t sample;
+
+  lis3mdl_linux_useScene(&scene);
+  CHECK(lis3mdl.begin_I2C());
+  lis3mdl.setDataRate(LIS3MDL_DATARATE_1000_HZ);
+  checkSettles(&lis3mdl, __LINE__);
+
+  testSingleShot(&lis3mdl);
+
+  // Back to continuous restarts the output
+  lis3mdl.setOperationMode(LIS3MDL_CONTINUOUSMODE);
+  checkSettles(&lis3mdl, __LINE__);
+  // Continuous again is no change
+  lis3mdl.setOperationMode(LIS3MDL_CONTINUOUSMODE);
+  CHECK(freshSample(&lis3mdl, &sample));
+  CHECK(!(sample.flags & LIS3MDL_FLAG_SETTLING));
+
+  lis3mdl.setRange(LIS3MDL_RANGE_4_GAUSS);
+  checkSettles(&lis3mdl, __LINE__);
+
+  lis3mdl_selftest_t selfTest;
+  lis3mdl.runSelfTest(&selfTest, 2);
+  checkSettles(&lis3mdl, __LINE__);
+
+  // Leave power-down with a raw write, which flags nothing by itself
+  uint8_t continuous = LIS3MDL_CONTINUOUSMODE;
+  lis3mdl.reset();
+  CHECK(lis3mdl.writeRegisters(LIS3MDL_REG_CTRL_REG3, &continuous, 1));
+  checkSettles(&lis3mdl, __LINE__);
+
+  lis3mdl_production_t production;
+  lis3mdl_productionTest(&lis3mdl, &production, NULL);
+  checkSettles(&lis3mdl, __LINE__);
+
+  lis3mdl_linux_useScene(NULL);
+  printf("%s\n", failures ? "FAILED" : "OK");
+  return failures ? 1 : 0;
+}
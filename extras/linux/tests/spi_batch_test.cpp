@@ -0,0 +1,172 @@
+/*!
+ * @file     spi_batch_test.cpp
+ *
+ * Checks the SPI_IOC_MESSAGE calls made by Adafruit_LIS3MDL_SPIBatch for
+ * reads spread over three spidev nodes. The scene's system call table
+ * answers the transfers; a thin wrapper hands each node its own descriptor
+ * and records every message before passing it on. Build from the library
+ * root like any other Linux program (see ../README.md); the program exits
+ * nonzero if a check fails.
+ *
+ * BSD license, all text here must be included in any redistribution.
+ *
+ */
+
+#include <Adafruit_LIS3MDL_SPIBatch.h>
+#include <Adafruit_LIS3MDL_SceneIO.h>
+#include <lis3mdl_linux_io.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <linux/spi/spidev.h>
+
+#define NODES 3     ///< spidev0.0 to spidev0.2
+#define NODE_FD 100 ///< Descriptor of spidev0.0, the others follow
+#define MAX_CALLS 8 ///< SPI_IOC_MESSAGE calls recorded
+
+static int failures = 0;
+
+#define CHECK(cond) check((cond), #cond, __LINE__)
+
+static void check(bool ok, const char *what, int line) {
+  if (!ok) {
+    printf("FAIL line %d: %s\n", line, what);
+    failures++;
+  }
+}
+
+/** One recorded SPI_IOC_MESSAGE */
+typedef struct {
+  int fd;              ///< Node the message went to
+  uint32_t count;      ///< Transfers in the message
+  uint32_t len[8];     ///< Length of each transfer
+  uint8_t csChange[8]; ///< cs_change of each transfer
+  uint8_t command[8];  ///< First byte sent by each transfer
+} message_t;
+
+static const lis3mdl_linux_io_t *scene_io;
+static int scene_fd = -1;
+static message_t calls[MAX_CALLS];
+static uint32_t ncalls;
+
+static int wrap_open(const char *path, int flags) {
+  int cs = path[strlen(path) - 1] - '0';
+  scene_fd = scene_io->open(path, flags);
+  return scene_fd < 0 ? scene_fd : NODE_FD + cs;
+}
+
+static int wrap_close(int fd) {
+  (void)fd;
+  return scene_io->close(scene_fd);
+}
+
+static ssize_t wrap_read(int fd, void *buf, size_t count) {
+  (void)fd;
+  return scene_io->read(scene_fd, buf, count);
+}
+
+static ssize_t wrap_write(int fd, const void *buf, size_t count) {
+  (void)fd;
+  return scene_io->write(scene_fd, buf, count);
+}
+
+static int wrap_ioctl(int fd, unsigned long request, void *arg) {
+  if (fd < NODE_FD || fd >= NODE_FD + NODES)
+    return -1;
+  if (_IOC_TYPE(request) == SPI_IOC_MAGIC && _IOC_NR(request) == 0 &&
+      ncalls < MAX_CALLS) {
+    struct spi_ioc_transfer *xfers = (struct spi_ioc_transfer *)arg;
+    message_t *m = &calls[ncalls++];
+    m->fd = fd;
+    m->count = _IOC_SIZE(request) / sizeof(struct spi_ioc_transfer);
+    for (uint32_t i = 0; i < m->count && i < 8; i++) {
+      m->len[i] = xfers[i].len;
+      m->csChange[i] = xfers[i].cs_change;
+      m->command[i] = *(uint8_t *)(uintptr_t)xfers[i].tx_buf;
+    }
+  }
+  return scene_io->ioctl(scene_fd, request, arg);
+}
+
+static const lis3mdl_linux_io_t wrap_io = {wrap_open, wrap_close, wrap_ioctl,
+                                           wrap_read, wrap_write};
+
+// One message to node fd, of count reads with the given commands and lengths
+static void checkMessage(const message_t *m, int fd, uint32_t count,
+                         const uint8_t *commands, const uint32_t *lens) {
+  CHECK(m->fd == fd);
+  CHECK(m->count == count);
+  for (uint32_t i = 0; i < count && i < m->count; i++) {
+    CHECK(m->command[i] == commands[i]);
+    CHECK(m->len[i] == lens[i]);
+    CHECK(m->csChange[i] == (i + 1 < count)); // deselect between frames
+  }
+}
+
+int main(void) {
+  Adafruit_LIS3MDL_Scene scene(7);
+  Adafruit_LIS3MDL lis3mdl;
+  lis3mdl_registers_t dump;
+
+  lis3mdl_linux_useScene(&scene);
+  scene_io = lis3mdl_linux_io();
+  lis3mdl_linux_setIO(&wrap_io);
+
+  // Configure through node 0; a slow rate keeps the output fixed for the test
+  CHECK(lis3mdl.begin_SPI(0));
+  lis3mdl.setRange(LIS3MDL_RANGE_8_GAUSS);
+  CHECK(lis3mdl.setDataRate(LIS3MDL_DATARATE_0_625_HZ));
+  lis3mdl.setOperationMode(LIS3MDL_CONTINUOUSMODE);
+  delay(10);
+  CHECK(lis3mdl.dumpRegisters(&dump));
+  lis3mdl_sample_t reference;
+  CHECK(lis3mdl.readSample(&reference));
+
+  Adafruit_SPIDevice cs0(0), cs1(1), cs2(2);
+  CHECK(cs0.begin() && cs1.begin() && cs2.begin());
+
+  Adafruit_LIS3MDL_SPIBatch batch;
+  lis3mdl_sample_t a, b, c;
+  uint8_t whoami = 0, ctrl[4] = {0};
+
+  // Interleaved over the nodes; each node's reads keep their order
+  CHECK(batch.addSample(&cs0, &a));
+  CHECK(batch.addSample(&cs1, &b));
+  CHECK(batch.addRead(&cs0, LIS3MDL_REG_WHO_AM_I, &whoami, 1));
+  CHECK(batch.addRead(&cs2, LIS3MDL_REG_CTRL_REG1, ctrl, 4));
+  CHECK(batch.addSample(&cs1, &c));
+
+  ncalls = 0;
+  CHECK(batch.transfer());
+  CHECK(batch.lastIoctls() == NODES);
+  CHECK(ncalls == NODES);
+
+  static const uint8_t cmd0[] = {0xE7, 0xCF}, cmd1[] = {0xE7, 0xE7},
+                       cmd2[] = {0xE0};
+  static const uint32_t len0[] = {8, 2}, len1[] = {8, 8}, len2[] = {5};
+  checkMessage(&calls[0], NODE_FD + 0, 2, cmd0, len0);
+  checkMessage(&calls[1], NODE_FD + 1, 2, cmd1, len1);
+  checkMessage(&calls[2], NODE_FD + 2, 1, cmd2, len2);
+
+  // Every node reaches the same emulated part
+  CHECK(whoami == 0x3D);
+  CHECK(memcmp(ctrl, dump.regs, 4) == 0);
+  CHECK(a.x == reference.x && a.y == reference.y && a.z == reference.z);
+  CHECK(b.x == reference.x && b.y == reference.y && b.z == reference.z);
+  CHECK(c.x == reference.x && c.y == reference.y && c.z == reference.z);
+
+  // A full batch refuses more reads
+  batch.clear();
+  uint8_t n = 0;
+  while (batch.addSample(n & 1 ? &cs1 : &cs0, &a))
+    n++;
+  CHECK(n == LIS3MDL_SPI_BATCH_MAX);
+  ncalls = 0;
+  CHECK(batch.transfer());
+  CHECK(ncalls == 2);
+  CHECK(calls[0].count == LIS3MDL_SPI_BATCH_MAX / 2);
+
+  lis3mdl_linux_useScene(NULL);
+  printf("%s\n", failures ? "FAILED" : "OK");
+  return failures ? 1 : 0;
+}